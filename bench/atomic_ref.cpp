@@ -0,0 +1,366 @@
+#include <avakar/atomic_ref.h>
+#include <avakar/fetch_update.h>
+#include <avakar/striped_counter.h>
+#include <benchmark/benchmark.h>
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+
+namespace {
+
+// Each benchmark runs an operation on a `T` with 1 to N threads, where N
+// is the number of hardware threads. The threads either share a single
+// object (true sharing), use adjacent objects (false sharing),
+// or objects on separate cache lines (uncontended).
+
+enum class layout
+{
+	uncontended,
+	true_sharing,
+	false_sharing,
+};
+
+char const * layout_name(layout l)
+{
+	switch (l)
+	{
+	case layout::uncontended:
+		return "uncontended";
+	case layout::true_sharing:
+		return "true_sharing";
+	default:
+		return "false_sharing";
+	}
+}
+
+constexpr int max_threads = 256;
+
+int thread_limit()
+{
+	return std::max(1, std::min<int>(max_threads, std::thread::hardware_concurrency()));
+}
+
+template <typename S>
+struct arena
+{
+	struct alignas(128) padded_t
+	{
+		S value;
+	};
+
+	static padded_t padded[max_threads];
+	alignas(128) static S packed[max_threads];
+
+	static S & object_for(layout l, int thread)
+	{
+		switch (l)
+		{
+		case layout::uncontended:
+			return padded[thread].value;
+		case layout::true_sharing:
+			return padded[0].value;
+		default:
+			return packed[thread];
+		}
+	}
+};
+
+template <typename S>
+typename arena<S>::padded_t arena<S>::padded[max_threads];
+
+template <typename S>
+alignas(128) S arena<S>::packed[max_threads];
+
+struct x16_t
+{
+	void * ptr;
+	std::uint64_t tag;
+};
+
+struct large_t
+{
+	std::uint64_t a, b, c, d;
+};
+
+template <typename T>
+T value_of(std::true_type)
+{
+	return T(1);
+}
+
+template <typename T>
+T value_of(std::false_type)
+{
+	return T{};
+}
+
+template <typename T>
+T value_of()
+{
+	return value_of<T>(std::integral_constant<bool, std::is_arithmetic<T>::value>());
+}
+
+// Implementations under test: `impl::ref(obj)` returns something with
+// the interface of `std::atomic<T>`.
+
+struct use_atomic_ref
+{
+	static constexpr char const * name = "atomic_ref";
+
+	template <typename T>
+	using storage = T;
+
+	template <typename T>
+	static avakar::atomic_ref<T> ref(T & obj)
+	{
+		return avakar::atomic_ref<T>(obj);
+	}
+};
+
+struct use_std_atomic
+{
+	static constexpr char const * name = "std_atomic";
+
+	template <typename T>
+	using storage = std::atomic<T>;
+
+	template <typename T>
+	static std::atomic<T> & ref(std::atomic<T> & obj)
+	{
+		return obj;
+	}
+};
+
+#if defined(__GNUC__)
+
+template <typename T>
+struct builtin_ref
+{
+	T & obj;
+
+	T load() const
+	{
+		return __atomic_load_n(&obj, __ATOMIC_SEQ_CST);
+	}
+
+	void store(T desired) const
+	{
+		__atomic_store_n(&obj, desired, __ATOMIC_SEQ_CST);
+	}
+
+	T exchange(T desired) const
+	{
+		return __atomic_exchange_n(&obj, desired, __ATOMIC_SEQ_CST);
+	}
+
+	bool compare_exchange_strong(T & expected, T desired) const
+	{
+		return __atomic_compare_exchange_n(&obj, &expected, desired, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+	}
+
+	template <typename U = T>
+	std::enable_if_t<!std::is_pointer<U>::value, T> fetch_add(T arg) const
+	{
+		return __atomic_fetch_add(&obj, arg, __ATOMIC_SEQ_CST);
+	}
+
+	template <typename U = T>
+	std::enable_if_t<std::is_pointer<U>::value, T> fetch_add(std::ptrdiff_t arg) const
+	{
+		return __atomic_fetch_add(&obj, arg * sizeof(*obj), __ATOMIC_SEQ_CST);
+	}
+
+	T fetch_or(T arg) const
+	{
+		return __atomic_fetch_or(&obj, arg, __ATOMIC_SEQ_CST);
+	}
+};
+
+struct use_builtins
+{
+	static constexpr char const * name = "builtins";
+
+	template <typename T>
+	using storage = T;
+
+	template <typename T>
+	static builtin_ref<T> ref(T & obj)
+	{
+		return builtin_ref<T>{ obj };
+	}
+};
+
+#endif
+
+struct op_load
+{
+	static constexpr char const * name = "load";
+
+	template <typename T, typename R>
+	static void run(R && r)
+	{
+		benchmark::DoNotOptimize(r.load());
+	}
+};
+
+struct op_store
+{
+	static constexpr char const * name = "store";
+
+	template <typename T, typename R>
+	static void run(R && r)
+	{
+		r.store(value_of<T>());
+	}
+};
+
+struct op_exchange
+{
+	static constexpr char const * name = "exchange";
+
+	template <typename T, typename R>
+	static void run(R && r)
+	{
+		benchmark::DoNotOptimize(r.exchange(value_of<T>()));
+	}
+};
+
+struct op_cas
+{
+	static constexpr char const * name = "compare_exchange";
+
+	template <typename T, typename R>
+	static void run(R && r)
+	{
+		T expected = value_of<T>();
+		benchmark::DoNotOptimize(r.compare_exchange_strong(expected, value_of<T>()));
+	}
+};
+
+struct op_fetch_add
+{
+	static constexpr char const * name = "fetch_add";
+
+	template <typename T, typename R>
+	static void run(R && r)
+	{
+		benchmark::DoNotOptimize(r.fetch_add(1));
+	}
+};
+
+struct op_fetch_or
+{
+	static constexpr char const * name = "fetch_or";
+
+	template <typename T, typename R>
+	static void run(R && r)
+	{
+		benchmark::DoNotOptimize(r.fetch_or(1));
+	}
+};
+
+template <typename Impl, typename T, typename Op>
+void run(benchmark::State & state, layout l)
+{
+	auto & obj = arena<typename Impl::template storage<T>>::object_for(l, state.thread_index());
+	for (auto _ : state)
+		Op::template run<T>(Impl::ref(obj));
+	state.SetItemsProcessed(state.iterations());
+}
+
+template <typename Impl, typename T>
+void register_ops(char const *)
+{
+}
+
+template <typename Impl, typename T, typename Op, typename... Ops>
+void register_ops(char const * type_name)
+{
+	for (layout l : { layout::uncontended, layout::true_sharing, layout::false_sharing })
+	{
+		std::string name = std::string(Op::name) + "/" + Impl::name + "/" + type_name + "/" + layout_name(l);
+		benchmark::RegisterBenchmark(name.c_str(), [l](benchmark::State & state) { run<Impl, T, Op>(state, l); })
+			->ThreadRange(1, thread_limit())
+			->UseRealTime();
+	}
+
+	register_ops<Impl, T, Ops...>(type_name);
+}
+
+template <typename Impl>
+void register_scalar()
+{
+	register_ops<Impl, std::uint8_t, op_load, op_store, op_exchange, op_cas, op_fetch_add, op_fetch_or>("u8");
+	register_ops<Impl, std::uint16_t, op_load, op_store, op_exchange, op_cas, op_fetch_add, op_fetch_or>("u16");
+	register_ops<Impl, std::uint32_t, op_load, op_store, op_exchange, op_cas, op_fetch_add, op_fetch_or>("u32");
+	register_ops<Impl, std::uint64_t, op_load, op_store, op_exchange, op_cas, op_fetch_add, op_fetch_or>("u64");
+	register_ops<Impl, int *, op_load, op_store, op_exchange, op_cas, op_fetch_add>("ptr");
+}
+
+// All threads increment one counter, either a single shared word
+// or a `striped_counter`.
+
+avakar::striped_counter<std::uint64_t> shared_striped_counter;
+
+void register_counters()
+{
+	benchmark::RegisterBenchmark("increment/atomic_ref/u64", [](benchmark::State & state) {
+		auto & obj = arena<std::uint64_t>::object_for(layout::true_sharing, state.thread_index());
+		for (auto _ : state)
+			avakar::atomic_ref<std::uint64_t>(obj).fetch_add(1, std::memory_order_relaxed);
+		state.SetItemsProcessed(state.iterations());
+	})->ThreadRange(1, thread_limit())->UseRealTime();
+
+	benchmark::RegisterBenchmark("increment/striped_counter/u64", [](benchmark::State & state) {
+		for (auto _ : state)
+			++shared_striped_counter;
+		state.SetItemsProcessed(state.iterations());
+	})->ThreadRange(1, thread_limit())->UseRealTime();
+}
+
+// All threads update one shared word with `fetch_update`,
+// comparing the backoff policies.
+
+template <typename Backoff>
+void register_update(char const * policy)
+{
+	std::string name = std::string("fetch_update/") + policy + "/u64";
+	benchmark::RegisterBenchmark(name.c_str(), [](benchmark::State & state) {
+		auto & obj = arena<std::uint64_t>::object_for(layout::true_sharing, state.thread_index());
+		for (auto _ : state)
+		{
+			avakar::fetch_update<Backoff>(avakar::atomic_ref<std::uint64_t>(obj),
+				[](std::uint64_t v) { return v * 3 + 1; }, std::memory_order_relaxed);
+		}
+		state.SetItemsProcessed(state.iterations());
+	})->ThreadRange(1, thread_limit())->UseRealTime();
+}
+
+void register_updates()
+{
+	register_update<avakar::no_backoff>("none");
+	register_update<avakar::pause_backoff>("pause");
+	register_update<avakar::jittered_backoff>("jittered");
+	register_update<avakar::yield_backoff>("yield");
+}
+
+int register_all()
+{
+	register_scalar<use_atomic_ref>();
+	register_scalar<use_std_atomic>();
+#if defined(__GNUC__)
+	register_scalar<use_builtins>();
+#endif
+
+	register_ops<use_atomic_ref, x16_t, op_load, op_store, op_exchange, op_cas>("x16");
+	register_ops<use_atomic_ref, large_t, op_load, op_store, op_exchange, op_cas>("large");
+	register_counters();
+	register_updates();
+	return 0;
+}
+
+int const registered = register_all();
+
+}
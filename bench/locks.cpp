@@ -0,0 +1,180 @@
+#include <avakar/flat_combining.h>
+#include <avakar/mcs_lock.h>
+#include <avakar/mutex.h>
+#include <avakar/ticket_lock.h>
+#include <benchmark/benchmark.h>
+#include <algorithm>
+#include <cstdint>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <thread>
+
+namespace {
+
+// All threads repeatedly take the same lock and increment a counter,
+// optionally doing `state.range(0)` units of work outside of
+// the critical section to vary the contention.
+
+int thread_limit()
+{
+	return std::max(1, std::min<int>(64, std::thread::hardware_concurrency()));
+}
+
+void work(std::int64_t units)
+{
+	for (std::int64_t i = 0; i != units; ++i)
+		benchmark::ClobberMemory();
+}
+
+template <typename Lock>
+struct lockable
+{
+	static constexpr char const * name = "";
+
+	Lock lock;
+
+	struct guard
+	{
+		explicit guard(lockable & l)
+			: _lock(l.lock)
+		{
+		}
+
+		std::lock_guard<Lock> _lock;
+	};
+};
+
+struct use_std_mutex
+	: lockable<std::mutex>
+{
+	static constexpr char const * name = "std_mutex";
+};
+
+struct use_mutex
+	: lockable<avakar::mutex>
+{
+	static constexpr char const * name = "mutex";
+};
+
+struct use_ticket_lock
+	: lockable<avakar::ticket_lock>
+{
+	static constexpr char const * name = "ticket_lock";
+};
+
+struct use_mcs_lock
+{
+	static constexpr char const * name = "mcs_lock";
+
+	avakar::mcs_lock lock;
+
+	struct guard
+	{
+		explicit guard(use_mcs_lock & l)
+			: _guard(l.lock)
+		{
+		}
+
+		avakar::mcs_lock::guard _guard;
+	};
+};
+
+template <typename L>
+struct shared_state
+{
+	static L lock;
+	alignas(128) static std::uint64_t counter;
+};
+
+template <typename L>
+L shared_state<L>::lock;
+
+template <typename L>
+alignas(128) std::uint64_t shared_state<L>::counter;
+
+template <typename L>
+void run(benchmark::State & state)
+{
+	for (auto _ : state)
+	{
+		{
+			typename L::guard g(shared_state<L>::lock);
+			++shared_state<L>::counter;
+		}
+
+		work(state.range(0));
+	}
+
+	state.SetItemsProcessed(state.iterations());
+}
+
+template <typename L>
+void register_lock()
+{
+	std::string name = std::string("lock/") + L::name;
+	benchmark::RegisterBenchmark(name.c_str(), run<L>)
+		->Arg(0)
+		->Arg(100)
+		->ThreadRange(1, thread_limit())
+		->UseRealTime();
+}
+
+// All threads push to and pop from one priority queue, either
+// under a mutex or through flat combining.
+
+using priority_queue = std::priority_queue<std::uint64_t>;
+
+std::mutex pq_mutex;
+priority_queue pq_locked;
+avakar::flat_combining<priority_queue> pq_combined;
+
+void pq_std_mutex(benchmark::State & state)
+{
+	std::uint64_t v = state.thread_index();
+	for (auto _ : state)
+	{
+		std::lock_guard<std::mutex> g(pq_mutex);
+		pq_locked.push(v);
+		v = pq_locked.top() * 3 + 1;
+		pq_locked.pop();
+	}
+
+	state.SetItemsProcessed(state.iterations());
+}
+
+void pq_flat_combining(benchmark::State & state)
+{
+	std::uint64_t v = state.thread_index();
+	for (auto _ : state)
+	{
+		v = pq_combined.apply([v](priority_queue & q) {
+			q.push(v);
+			std::uint64_t r = q.top() * 3 + 1;
+			q.pop();
+			return r;
+		});
+	}
+
+	state.SetItemsProcessed(state.iterations());
+}
+
+int register_all()
+{
+	register_lock<use_std_mutex>();
+	register_lock<use_mutex>();
+	register_lock<use_ticket_lock>();
+	register_lock<use_mcs_lock>();
+
+	benchmark::RegisterBenchmark("priority_queue/std_mutex", pq_std_mutex)
+		->ThreadRange(1, thread_limit())
+		->UseRealTime();
+	benchmark::RegisterBenchmark("priority_queue/flat_combining", pq_flat_combining)
+		->ThreadRange(1, thread_limit())
+		->UseRealTime();
+	return 0;
+}
+
+int const registered = register_all();
+
+}
@@ -0,0 +1,74 @@
+#include <avakar/object_pool.h>
+#include <benchmark/benchmark.h>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace {
+
+// Every benchmark thread allocates `state.range(0)` buffers and frees
+// them again, either through a mutex-protected free list or through
+// its own `object_pool` cache.
+
+struct buffer
+{
+	char data[256];
+};
+
+std::mutex free_list_mutex;
+std::vector<buffer *> free_list;
+
+void pool_mutex_free_list(benchmark::State & state)
+{
+	std::vector<buffer *> held;
+	for (auto _ : state)
+	{
+		for (std::int64_t i = 0; i != state.range(0); ++i)
+		{
+			std::lock_guard<std::mutex> g(free_list_mutex);
+			if (free_list.empty())
+			{
+				held.push_back(new buffer());
+			}
+			else
+			{
+				held.push_back(free_list.back());
+				free_list.pop_back();
+			}
+		}
+
+		for (buffer * b: held)
+		{
+			std::lock_guard<std::mutex> g(free_list_mutex);
+			free_list.push_back(b);
+		}
+		held.clear();
+	}
+
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+avakar::object_pool<buffer> shared_pool;
+
+void pool_object_pool(benchmark::State & state)
+{
+	avakar::object_pool<buffer>::cache cache(shared_pool);
+
+	std::vector<buffer *> held;
+	for (auto _ : state)
+	{
+		for (std::int64_t i = 0; i != state.range(0); ++i)
+			held.push_back(cache.allocate());
+
+		for (buffer * b: held)
+			cache.deallocate(b);
+		held.clear();
+	}
+
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+BENCHMARK(pool_mutex_free_list)->Arg(1)->Arg(64)->ThreadRange(1, 16)->UseRealTime();
+BENCHMARK(pool_object_pool)->Arg(1)->Arg(64)->ThreadRange(1, 16)->UseRealTime();
+
+}
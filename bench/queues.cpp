@@ -0,0 +1,74 @@
+#include <avakar/mpmc_queue.h>
+#include <avakar/spsc_queue.h>
+#include <benchmark/benchmark.h>
+#include <atomic>
+#include <cstdint>
+#include <thread>
+
+namespace {
+
+// The benchmark thread produces batches of `state.range(0)` integers,
+// which a separate consumer thread drains in batches of the same size.
+
+void spsc_throughput(benchmark::State & state)
+{
+	std::size_t const batch = static_cast<std::size_t>(state.range(0));
+	avakar::spsc_queue<std::uint64_t> q(4096);
+
+	std::atomic<bool> done{ false };
+	std::thread consumer([&] {
+		std::uint64_t buf[256];
+		for (;;)
+		{
+			std::size_t n = q.pop_n(buf, batch);
+			benchmark::DoNotOptimize(buf);
+			if (n == 0 && done.load(std::memory_order_acquire) && q.empty())
+				break;
+		}
+	});
+
+	std::uint64_t buf[256] = {};
+	for (auto _ : state)
+	{
+		std::size_t pushed = 0;
+		while (pushed != batch)
+			pushed += q.push_n(buf + pushed, batch - pushed);
+	}
+
+	done.store(true, std::memory_order_release);
+	consumer.join();
+
+	state.SetItemsProcessed(state.iterations() * batch);
+	state.SetBytesProcessed(state.iterations() * batch * sizeof(std::uint64_t));
+}
+
+BENCHMARK(spsc_throughput)->RangeMultiplier(4)->Range(1, 256)->UseRealTime();
+
+// Every benchmark thread alternates between pushing and popping,
+// so the queue never fills up and the threads contend on both ends.
+// A queue that supports blocking pays a fence on every hand-over.
+
+template <bool blocking>
+void mpmc_push_pop(benchmark::State & state)
+{
+	static avakar::mpmc_queue<std::uint64_t, blocking> q(1024);
+
+	std::uint64_t v = 0;
+	for (auto _ : state)
+	{
+		while (!q.try_push(v))
+		{
+		}
+
+		while (!q.try_pop(v))
+		{
+		}
+	}
+
+	state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK_TEMPLATE(mpmc_push_pop, false)->ThreadRange(1, 16)->UseRealTime();
+BENCHMARK_TEMPLATE(mpmc_push_pop, true)->ThreadRange(1, 16)->UseRealTime();
+
+}
@@ -3,6 +3,9 @@
 
 #include <atomic>
 #include <cstddef>
+#include <type_traits>
+
+#include "memory_order.h"
 
 #if defined(_MSC_VER) && defined(_M_IX86)
 #include "../../src/atomic_ref.msvc.x86.h"
@@ -22,12 +25,25 @@ struct _atomic;
 template <typename T>
 using safe_atomic = _atomic<T>;
 
+// The operand type of the compound assignment operators. Only integral,
+// floating-point and pointer types have a `difference_type`; for the rest
+// the operators are never instantiated.
+template <typename T, typename = void>
+struct _atomic_difference_type
+{
+	using type = T;
+};
+
+template <typename T>
+struct _atomic_difference_type<T, std::enable_if_t<!std::is_void<typename _atomic<T>::difference_type>::value>>
+{
+	using type = typename _atomic<T>::difference_type;
+};
+
 template <typename T>
 struct atomic
 	: _atomic<T>
 {
-	using difference_type = typename _atomic<T>::difference_type;
-
 	explicit atomic() noexcept
 		: _atomic<T>()
 	{
@@ -38,59 +54,70 @@ struct atomic
 	{
 	}
 
-	operator T() const noexcept
+	AVAKAR_ATOMIC_REF_ENTRY operator T() const noexcept
 	{
+		AVAKAR_ATOMIC_REF_SITE();
 		return this->load();
 	}
 
-	T operator=(T desired) noexcept
+	AVAKAR_ATOMIC_REF_ENTRY T operator=(T desired) noexcept
 	{
+		AVAKAR_ATOMIC_REF_SITE();
 		this->store(desired);
 		return desired;
 	}
 
-	T operator++() noexcept
+	AVAKAR_ATOMIC_REF_ENTRY T operator++() noexcept
 	{
+		AVAKAR_ATOMIC_REF_SITE();
 		return this->fetch_add(1) + T(1);
 	}
 
-	T operator++(int) noexcept
+	AVAKAR_ATOMIC_REF_ENTRY T operator++(int) noexcept
 	{
+		AVAKAR_ATOMIC_REF_SITE();
 		return this->fetch_add(1);
 	}
 
-	T operator--() noexcept
+	AVAKAR_ATOMIC_REF_ENTRY T operator--() noexcept
 	{
+		AVAKAR_ATOMIC_REF_SITE();
 		return this->fetch_sub(1) - T(1);
 	}
 
-	T operator--(int) noexcept
+	AVAKAR_ATOMIC_REF_ENTRY T operator--(int) noexcept
 	{
+		AVAKAR_ATOMIC_REF_SITE();
 		return this->fetch_sub(1);
 	}
 
-	T operator+=(difference_type arg) noexcept
+	AVAKAR_ATOMIC_REF_ENTRY T operator+=(typename _atomic_difference_type<T>::type arg) noexcept
 	{
+		AVAKAR_ATOMIC_REF_SITE();
 		return this->fetch_add(arg) + arg;
 	}
 
-	T operator-=(difference_type arg) noexcept
+	AVAKAR_ATOMIC_REF_ENTRY T operator-=(typename _atomic_difference_type<T>::type arg) noexcept
 	{
+		AVAKAR_ATOMIC_REF_SITE();
 		return this->fetch_sub(arg) - arg;
 	}
 
-	T operator&=(T arg) noexcept
+	AVAKAR_ATOMIC_REF_ENTRY T operator&=(T arg) noexcept
 	{
+		AVAKAR_ATOMIC_REF_SITE();
 		return this->fetch_and(arg) & arg;
 	}
 
-	T operator|=(T arg) noexcept
+	AVAKAR_ATOMIC_REF_ENTRY T operator|=(T arg) noexcept
 	{
+		AVAKAR_ATOMIC_REF_SITE();
 		return this->fetch_or(arg) | arg;
 	}
 
-	T operator^=(T arg) noexcept
+	AVAKAR_ATOMIC_REF_ENTRY T operator^=(T arg) noexcept
 	{
+		AVAKAR_ATOMIC_REF_SITE();
 		return this->fetch_xor(arg) ^ arg;
 	}
 };
@@ -103,7 +130,7 @@ struct _atomic
 
 	static constexpr bool is_always_lock_free = _avakar::atomic_ref::is_always_lock_free<T>::value;
 	static constexpr bool is_always_wait_free = _avakar::atomic_ref::is_always_wait_free<T>::value;
-	static constexpr std::size_t required_alignment = alignof(T);
+	static constexpr std::size_t required_alignment = _avakar::atomic_ref::required_alignment<T>::value;
 
 	using value_type = T;
 
@@ -116,49 +143,134 @@ struct _atomic
 	{
 	}
 
-	value_type load(std::memory_order order = std::memory_order_seq_cst) const noexcept
+	bool is_lock_free() const noexcept
+	{
+		return _avakar::atomic_ref::is_lock_free<value_type>();
+	}
+
+	AVAKAR_ATOMIC_REF_ENTRY value_type load(std::memory_order order = std::memory_order_seq_cst) const noexcept
 	{
+		AVAKAR_ATOMIC_REF_SITE();
 		return _avakar::atomic_ref::load(_obj, order);
 	}
 
-	void store(value_type desired, std::memory_order order = std::memory_order_seq_cst) noexcept
+	template <std::memory_order order>
+	AVAKAR_ATOMIC_REF_ENTRY value_type load(memory_order_t<order> = {}) const noexcept
 	{
+		AVAKAR_ATOMIC_REF_SITE();
+		return _avakar::atomic_ref::load(_obj, memory_order_t<order>());
+	}
+
+	AVAKAR_ATOMIC_REF_ENTRY void store(value_type desired, std::memory_order order = std::memory_order_seq_cst) noexcept
+	{
+		AVAKAR_ATOMIC_REF_SITE();
 		_avakar::atomic_ref::store(_obj, desired, order);
 	}
 
-	value_type exchange(value_type desired, std::memory_order order = std::memory_order_seq_cst) noexcept
+	template <std::memory_order order>
+	AVAKAR_ATOMIC_REF_ENTRY void store(value_type desired, memory_order_t<order> = {}) noexcept
+	{
+		AVAKAR_ATOMIC_REF_SITE();
+		_avakar::atomic_ref::store(_obj, desired, memory_order_t<order>());
+	}
+
+	AVAKAR_ATOMIC_REF_ENTRY value_type exchange(value_type desired, std::memory_order order = std::memory_order_seq_cst) noexcept
 	{
+		AVAKAR_ATOMIC_REF_SITE();
 		return _avakar::atomic_ref::exchange(_obj, desired, order);
 	}
 
-	bool compare_exchange_weak(value_type & expected, value_type desired, std::memory_order order = std::memory_order_seq_cst) noexcept
+	template <std::memory_order order>
+	AVAKAR_ATOMIC_REF_ENTRY value_type exchange(value_type desired, memory_order_t<order> = {}) noexcept
+	{
+		AVAKAR_ATOMIC_REF_SITE();
+		return _avakar::atomic_ref::exchange(_obj, desired, memory_order_t<order>());
+	}
+
+	AVAKAR_ATOMIC_REF_ENTRY bool compare_exchange_weak(value_type & expected, value_type desired, std::memory_order order = std::memory_order_seq_cst) noexcept
 	{
+		AVAKAR_ATOMIC_REF_SITE();
 		return this->compare_exchange_weak(expected, desired, order, order);
 	}
 
-	bool compare_exchange_weak(
+	template <std::memory_order order>
+	AVAKAR_ATOMIC_REF_ENTRY bool compare_exchange_weak(value_type & expected, value_type desired, memory_order_t<order> = {}) noexcept
+	{
+		AVAKAR_ATOMIC_REF_SITE();
+		return _avakar::atomic_ref::_record_cas(_avakar::atomic_ref::compare_exchange_weak(_obj, expected, desired, memory_order_t<order>(), _failure_order_t<order>()));
+	}
+
+	AVAKAR_ATOMIC_REF_ENTRY bool compare_exchange_weak(
 		value_type & expected, value_type desired,
 		std::memory_order success,
 		std::memory_order failure) noexcept
 	{
-		return _avakar::atomic_ref::compare_exchange_weak(_obj, expected, desired, success, failure);
+		AVAKAR_ATOMIC_REF_SITE();
+		return _avakar::atomic_ref::_record_cas(_avakar::atomic_ref::compare_exchange_weak(_obj, expected, desired, success, failure));
 	}
 
-	bool compare_exchange_strong(value_type & expected, value_type desired, std::memory_order order = std::memory_order_seq_cst) noexcept
+	template <std::memory_order success, std::memory_order failure>
+	AVAKAR_ATOMIC_REF_ENTRY bool compare_exchange_weak(
+		value_type & expected, value_type desired,
+		memory_order_t<success> = {},
+		memory_order_t<failure> = {}) noexcept
 	{
+		AVAKAR_ATOMIC_REF_SITE();
+		return _avakar::atomic_ref::_record_cas(_avakar::atomic_ref::compare_exchange_weak(_obj, expected, desired, memory_order_t<success>(), memory_order_t<failure>()));
+	}
+
+	AVAKAR_ATOMIC_REF_ENTRY bool compare_exchange_strong(value_type & expected, value_type desired, std::memory_order order = std::memory_order_seq_cst) noexcept
+	{
+		AVAKAR_ATOMIC_REF_SITE();
 		return this->compare_exchange_strong(expected, desired, order, order);
 	}
 
-	bool compare_exchange_strong(
+	template <std::memory_order order>
+	AVAKAR_ATOMIC_REF_ENTRY bool compare_exchange_strong(value_type & expected, value_type desired, memory_order_t<order> = {}) noexcept
+	{
+		AVAKAR_ATOMIC_REF_SITE();
+		return _avakar::atomic_ref::_record_cas(_avakar::atomic_ref::compare_exchange_strong(_obj, expected, desired, memory_order_t<order>(), _failure_order_t<order>()));
+	}
+
+	AVAKAR_ATOMIC_REF_ENTRY bool compare_exchange_strong(
 		value_type & expected, value_type desired,
 		std::memory_order success,
 		std::memory_order failure) noexcept
 	{
-		return _avakar::atomic_ref::compare_exchange_strong(_obj, expected, desired, success, failure);
+		AVAKAR_ATOMIC_REF_SITE();
+		return _avakar::atomic_ref::_record_cas(_avakar::atomic_ref::compare_exchange_strong(_obj, expected, desired, success, failure));
+	}
+
+	template <std::memory_order success, std::memory_order failure>
+	AVAKAR_ATOMIC_REF_ENTRY bool compare_exchange_strong(
+		value_type & expected, value_type desired,
+		memory_order_t<success> = {},
+		memory_order_t<failure> = {}) noexcept
+	{
+		AVAKAR_ATOMIC_REF_SITE();
+		return _avakar::atomic_ref::_record_cas(_avakar::atomic_ref::compare_exchange_strong(_obj, expected, desired, memory_order_t<success>(), memory_order_t<failure>()));
+	}
+
+	AVAKAR_ATOMIC_REF_ENTRY void wait(value_type old, std::memory_order order = std::memory_order_seq_cst) const noexcept
+	{
+		AVAKAR_ATOMIC_REF_SITE();
+		_avakar::atomic_ref::wait(_obj, old, order);
+	}
+
+	AVAKAR_ATOMIC_REF_ENTRY void notify_one() noexcept
+	{
+		AVAKAR_ATOMIC_REF_SITE();
+		_avakar::atomic_ref::notify_one(_obj);
+	}
+
+	AVAKAR_ATOMIC_REF_ENTRY void notify_all() noexcept
+	{
+		AVAKAR_ATOMIC_REF_SITE();
+		_avakar::atomic_ref::notify_all(_obj);
 	}
 
 private:
-	value_type _obj;
+	alignas(required_alignment) value_type _obj;
 };
 
 template <typename T>
@@ -166,7 +278,7 @@ struct _atomic<T *>
 {
 	static constexpr bool is_always_lock_free = _avakar::atomic_ref::is_always_lock_free<T *>::value;
 	static constexpr bool is_always_wait_free = _avakar::atomic_ref::is_always_wait_free<T *>::value;
-	static constexpr std::size_t required_alignment = alignof(T *);
+	static constexpr std::size_t required_alignment = _avakar::atomic_ref::required_alignment<T *>::value;
 
 	using value_type = T *;
 	using difference_type = std::ptrdiff_t;
@@ -180,59 +292,172 @@ struct _atomic<T *>
 	{
 	}
 
-	value_type load(std::memory_order order = std::memory_order_seq_cst) const noexcept
+	bool is_lock_free() const noexcept
+	{
+		return _avakar::atomic_ref::is_lock_free<value_type>();
+	}
+
+	AVAKAR_ATOMIC_REF_ENTRY value_type load(std::memory_order order = std::memory_order_seq_cst) const noexcept
 	{
+		AVAKAR_ATOMIC_REF_SITE();
 		return _avakar::atomic_ref::load(_obj, order);
 	}
 
-	void store(value_type desired, std::memory_order order = std::memory_order_seq_cst) noexcept
+	template <std::memory_order order>
+	AVAKAR_ATOMIC_REF_ENTRY value_type load(memory_order_t<order> = {}) const noexcept
+	{
+		AVAKAR_ATOMIC_REF_SITE();
+		return _avakar::atomic_ref::load(_obj, memory_order_t<order>());
+	}
+
+	AVAKAR_ATOMIC_REF_ENTRY void store(value_type desired, std::memory_order order = std::memory_order_seq_cst) noexcept
 	{
+		AVAKAR_ATOMIC_REF_SITE();
 		_avakar::atomic_ref::store(_obj, desired, order);
 	}
 
-	value_type exchange(value_type desired, std::memory_order order = std::memory_order_seq_cst) noexcept
+	template <std::memory_order order>
+	AVAKAR_ATOMIC_REF_ENTRY void store(value_type desired, memory_order_t<order> = {}) noexcept
 	{
+		AVAKAR_ATOMIC_REF_SITE();
+		_avakar::atomic_ref::store(_obj, desired, memory_order_t<order>());
+	}
+
+	AVAKAR_ATOMIC_REF_ENTRY value_type exchange(value_type desired, std::memory_order order = std::memory_order_seq_cst) noexcept
+	{
+		AVAKAR_ATOMIC_REF_SITE();
 		return _avakar::atomic_ref::exchange(_obj, desired, order);
 	}
 
-	bool compare_exchange_weak(value_type & expected, value_type desired, std::memory_order order = std::memory_order_seq_cst) noexcept
+	template <std::memory_order order>
+	AVAKAR_ATOMIC_REF_ENTRY value_type exchange(value_type desired, memory_order_t<order> = {}) noexcept
+	{
+		AVAKAR_ATOMIC_REF_SITE();
+		return _avakar::atomic_ref::exchange(_obj, desired, memory_order_t<order>());
+	}
+
+	AVAKAR_ATOMIC_REF_ENTRY bool compare_exchange_weak(value_type & expected, value_type desired, std::memory_order order = std::memory_order_seq_cst) noexcept
 	{
+		AVAKAR_ATOMIC_REF_SITE();
 		return this->compare_exchange_weak(expected, desired, order, order);
 	}
 
-	bool compare_exchange_weak(
+	template <std::memory_order order>
+	AVAKAR_ATOMIC_REF_ENTRY bool compare_exchange_weak(value_type & expected, value_type desired, memory_order_t<order> = {}) noexcept
+	{
+		AVAKAR_ATOMIC_REF_SITE();
+		return _avakar::atomic_ref::_record_cas(_avakar::atomic_ref::compare_exchange_weak(_obj, expected, desired, memory_order_t<order>(), _failure_order_t<order>()));
+	}
+
+	AVAKAR_ATOMIC_REF_ENTRY bool compare_exchange_weak(
 		value_type & expected, value_type desired,
 		std::memory_order success,
 		std::memory_order failure) noexcept
 	{
-		return _avakar::atomic_ref::compare_exchange_weak(_obj, expected, desired, success, failure);
+		AVAKAR_ATOMIC_REF_SITE();
+		return _avakar::atomic_ref::_record_cas(_avakar::atomic_ref::compare_exchange_weak(_obj, expected, desired, success, failure));
+	}
+
+	template <std::memory_order success, std::memory_order failure>
+	AVAKAR_ATOMIC_REF_ENTRY bool compare_exchange_weak(
+		value_type & expected, value_type desired,
+		memory_order_t<success> = {},
+		memory_order_t<failure> = {}) noexcept
+	{
+		AVAKAR_ATOMIC_REF_SITE();
+		return _avakar::atomic_ref::_record_cas(_avakar::atomic_ref::compare_exchange_weak(_obj, expected, desired, memory_order_t<success>(), memory_order_t<failure>()));
 	}
 
-	bool compare_exchange_strong(value_type & expected, value_type desired, std::memory_order order = std::memory_order_seq_cst) noexcept
+	AVAKAR_ATOMIC_REF_ENTRY bool compare_exchange_strong(value_type & expected, value_type desired, std::memory_order order = std::memory_order_seq_cst) noexcept
 	{
+		AVAKAR_ATOMIC_REF_SITE();
 		return this->compare_exchange_strong(expected, desired, order, order);
 	}
 
-	bool compare_exchange_strong(
+	template <std::memory_order order>
+	AVAKAR_ATOMIC_REF_ENTRY bool compare_exchange_strong(value_type & expected, value_type desired, memory_order_t<order> = {}) noexcept
+	{
+		AVAKAR_ATOMIC_REF_SITE();
+		return _avakar::atomic_ref::_record_cas(_avakar::atomic_ref::compare_exchange_strong(_obj, expected, desired, memory_order_t<order>(), _failure_order_t<order>()));
+	}
+
+	AVAKAR_ATOMIC_REF_ENTRY bool compare_exchange_strong(
 		value_type & expected, value_type desired,
 		std::memory_order success,
 		std::memory_order failure) noexcept
 	{
-		return _avakar::atomic_ref::compare_exchange_strong(_obj, expected, desired, success, failure);
+		AVAKAR_ATOMIC_REF_SITE();
+		return _avakar::atomic_ref::_record_cas(_avakar::atomic_ref::compare_exchange_strong(_obj, expected, desired, success, failure));
 	}
 
-	value_type fetch_add(difference_type arg, std::memory_order order = std::memory_order_seq_cst) noexcept
+	template <std::memory_order success, std::memory_order failure>
+	AVAKAR_ATOMIC_REF_ENTRY bool compare_exchange_strong(
+		value_type & expected, value_type desired,
+		memory_order_t<success> = {},
+		memory_order_t<failure> = {}) noexcept
 	{
+		AVAKAR_ATOMIC_REF_SITE();
+		return _avakar::atomic_ref::_record_cas(_avakar::atomic_ref::compare_exchange_strong(_obj, expected, desired, memory_order_t<success>(), memory_order_t<failure>()));
+	}
+
+	AVAKAR_ATOMIC_REF_ENTRY void wait(value_type old, std::memory_order order = std::memory_order_seq_cst) const noexcept
+	{
+		AVAKAR_ATOMIC_REF_SITE();
+		_avakar::atomic_ref::wait(_obj, old, order);
+	}
+
+	AVAKAR_ATOMIC_REF_ENTRY void notify_one() noexcept
+	{
+		AVAKAR_ATOMIC_REF_SITE();
+		_avakar::atomic_ref::notify_one(_obj);
+	}
+
+	AVAKAR_ATOMIC_REF_ENTRY void notify_all() noexcept
+	{
+		AVAKAR_ATOMIC_REF_SITE();
+		_avakar::atomic_ref::notify_all(_obj);
+	}
+
+	AVAKAR_ATOMIC_REF_ENTRY value_type fetch_add(difference_type arg, std::memory_order order = std::memory_order_seq_cst) noexcept
+	{
+		AVAKAR_ATOMIC_REF_SITE();
 		return _avakar::atomic_ref::fetch_add(_obj, arg, order);
 	}
 
-	value_type fetch_sub(difference_type arg, std::memory_order order = std::memory_order_seq_cst) noexcept
+	template <std::memory_order order>
+	AVAKAR_ATOMIC_REF_ENTRY value_type fetch_add(difference_type arg, memory_order_t<order> = {}) noexcept
 	{
+		AVAKAR_ATOMIC_REF_SITE();
+		return _avakar::atomic_ref::fetch_add(_obj, arg, memory_order_t<order>());
+	}
+
+	AVAKAR_ATOMIC_REF_ENTRY value_type fetch_sub(difference_type arg, std::memory_order order = std::memory_order_seq_cst) noexcept
+	{
+		AVAKAR_ATOMIC_REF_SITE();
 		return _avakar::atomic_ref::fetch_sub(_obj, arg, order);
 	}
 
+	template <std::memory_order order>
+	AVAKAR_ATOMIC_REF_ENTRY value_type fetch_sub(difference_type arg, memory_order_t<order> = {}) noexcept
+	{
+		AVAKAR_ATOMIC_REF_SITE();
+		return _avakar::atomic_ref::fetch_sub(_obj, arg, memory_order_t<order>());
+	}
+
+	AVAKAR_ATOMIC_REF_ENTRY value_type fetch_max(value_type arg, std::memory_order order = std::memory_order_seq_cst) noexcept
+	{
+		AVAKAR_ATOMIC_REF_SITE();
+		return _avakar::atomic_ref::fetch_max(_obj, arg, order);
+	}
+
+	AVAKAR_ATOMIC_REF_ENTRY value_type fetch_min(value_type arg, std::memory_order order = std::memory_order_seq_cst) noexcept
+	{
+		AVAKAR_ATOMIC_REF_SITE();
+		return _avakar::atomic_ref::fetch_min(_obj, arg, order);
+	}
+
 private:
-	value_type _obj;
+	alignas(required_alignment) value_type _obj;
 };
 
 template <typename T>
@@ -242,7 +467,7 @@ struct _atomic<T, std::enable_if_t<std::is_integral<T>::value>>
 
 	static constexpr bool is_always_lock_free = _avakar::atomic_ref::is_always_lock_free<T>::value;
 	static constexpr bool is_always_wait_free = _avakar::atomic_ref::is_always_wait_free<T>::value;
-	static constexpr std::size_t required_alignment = alignof(T);
+	static constexpr std::size_t required_alignment = _avakar::atomic_ref::required_alignment<T>::value;
 
 	using value_type = T;
 	using difference_type = T;
@@ -256,74 +481,418 @@ struct _atomic<T, std::enable_if_t<std::is_integral<T>::value>>
 	{
 	}
 
-	value_type load(std::memory_order order = std::memory_order_seq_cst) const noexcept
+	bool is_lock_free() const noexcept
 	{
+		return _avakar::atomic_ref::is_lock_free<value_type>();
+	}
+
+	AVAKAR_ATOMIC_REF_ENTRY value_type load(std::memory_order order = std::memory_order_seq_cst) const noexcept
+	{
+		AVAKAR_ATOMIC_REF_SITE();
 		return _avakar::atomic_ref::load(_obj, order);
 	}
 
-	void store(value_type desired, std::memory_order order = std::memory_order_seq_cst) noexcept
+	template <std::memory_order order>
+	AVAKAR_ATOMIC_REF_ENTRY value_type load(memory_order_t<order> = {}) const noexcept
+	{
+		AVAKAR_ATOMIC_REF_SITE();
+		return _avakar::atomic_ref::load(_obj, memory_order_t<order>());
+	}
+
+	AVAKAR_ATOMIC_REF_ENTRY void store(value_type desired, std::memory_order order = std::memory_order_seq_cst) noexcept
 	{
+		AVAKAR_ATOMIC_REF_SITE();
 		_avakar::atomic_ref::store(_obj, desired, order);
 	}
 
-	value_type exchange(value_type desired, std::memory_order order = std::memory_order_seq_cst) noexcept
+	template <std::memory_order order>
+	AVAKAR_ATOMIC_REF_ENTRY void store(value_type desired, memory_order_t<order> = {}) noexcept
+	{
+		AVAKAR_ATOMIC_REF_SITE();
+		_avakar::atomic_ref::store(_obj, desired, memory_order_t<order>());
+	}
+
+	AVAKAR_ATOMIC_REF_ENTRY value_type exchange(value_type desired, std::memory_order order = std::memory_order_seq_cst) noexcept
 	{
+		AVAKAR_ATOMIC_REF_SITE();
 		return _avakar::atomic_ref::exchange(_obj, desired, order);
 	}
 
-	bool compare_exchange_weak(value_type & expected, value_type desired, std::memory_order order = std::memory_order_seq_cst) noexcept
+	template <std::memory_order order>
+	AVAKAR_ATOMIC_REF_ENTRY value_type exchange(value_type desired, memory_order_t<order> = {}) noexcept
 	{
+		AVAKAR_ATOMIC_REF_SITE();
+		return _avakar::atomic_ref::exchange(_obj, desired, memory_order_t<order>());
+	}
+
+	AVAKAR_ATOMIC_REF_ENTRY bool compare_exchange_weak(value_type & expected, value_type desired, std::memory_order order = std::memory_order_seq_cst) noexcept
+	{
+		AVAKAR_ATOMIC_REF_SITE();
 		return this->compare_exchange_weak(expected, desired, order, order);
 	}
 
-	bool compare_exchange_weak(
+	template <std::memory_order order>
+	AVAKAR_ATOMIC_REF_ENTRY bool compare_exchange_weak(value_type & expected, value_type desired, memory_order_t<order> = {}) noexcept
+	{
+		AVAKAR_ATOMIC_REF_SITE();
+		return _avakar::atomic_ref::_record_cas(_avakar::atomic_ref::compare_exchange_weak(_obj, expected, desired, memory_order_t<order>(), _failure_order_t<order>()));
+	}
+
+	AVAKAR_ATOMIC_REF_ENTRY bool compare_exchange_weak(
 		value_type & expected, value_type desired,
 		std::memory_order success,
 		std::memory_order failure) noexcept
 	{
-		return _avakar::atomic_ref::compare_exchange_weak(_obj, expected, desired, success, failure);
+		AVAKAR_ATOMIC_REF_SITE();
+		return _avakar::atomic_ref::_record_cas(_avakar::atomic_ref::compare_exchange_weak(_obj, expected, desired, success, failure));
 	}
 
-	bool compare_exchange_strong(value_type & expected, value_type desired, std::memory_order order = std::memory_order_seq_cst) noexcept
+	template <std::memory_order success, std::memory_order failure>
+	AVAKAR_ATOMIC_REF_ENTRY bool compare_exchange_weak(
+		value_type & expected, value_type desired,
+		memory_order_t<success> = {},
+		memory_order_t<failure> = {}) noexcept
 	{
+		AVAKAR_ATOMIC_REF_SITE();
+		return _avakar::atomic_ref::_record_cas(_avakar::atomic_ref::compare_exchange_weak(_obj, expected, desired, memory_order_t<success>(), memory_order_t<failure>()));
+	}
+
+	AVAKAR_ATOMIC_REF_ENTRY bool compare_exchange_strong(value_type & expected, value_type desired, std::memory_order order = std::memory_order_seq_cst) noexcept
+	{
+		AVAKAR_ATOMIC_REF_SITE();
 		return this->compare_exchange_strong(expected, desired, order, order);
 	}
 
-	bool compare_exchange_strong(
+	template <std::memory_order order>
+	AVAKAR_ATOMIC_REF_ENTRY bool compare_exchange_strong(value_type & expected, value_type desired, memory_order_t<order> = {}) noexcept
+	{
+		AVAKAR_ATOMIC_REF_SITE();
+		return _avakar::atomic_ref::_record_cas(_avakar::atomic_ref::compare_exchange_strong(_obj, expected, desired, memory_order_t<order>(), _failure_order_t<order>()));
+	}
+
+	AVAKAR_ATOMIC_REF_ENTRY bool compare_exchange_strong(
 		value_type & expected, value_type desired,
 		std::memory_order success,
 		std::memory_order failure) noexcept
 	{
-		return _avakar::atomic_ref::compare_exchange_strong(_obj, expected, desired, success, failure);
+		AVAKAR_ATOMIC_REF_SITE();
+		return _avakar::atomic_ref::_record_cas(_avakar::atomic_ref::compare_exchange_strong(_obj, expected, desired, success, failure));
 	}
 
-	value_type fetch_add(difference_type arg, std::memory_order order = std::memory_order_seq_cst) noexcept
+	template <std::memory_order success, std::memory_order failure>
+	AVAKAR_ATOMIC_REF_ENTRY bool compare_exchange_strong(
+		value_type & expected, value_type desired,
+		memory_order_t<success> = {},
+		memory_order_t<failure> = {}) noexcept
 	{
+		AVAKAR_ATOMIC_REF_SITE();
+		return _avakar::atomic_ref::_record_cas(_avakar::atomic_ref::compare_exchange_strong(_obj, expected, desired, memory_order_t<success>(), memory_order_t<failure>()));
+	}
+
+	AVAKAR_ATOMIC_REF_ENTRY void wait(value_type old, std::memory_order order = std::memory_order_seq_cst) const noexcept
+	{
+		AVAKAR_ATOMIC_REF_SITE();
+		_avakar::atomic_ref::wait(_obj, old, order);
+	}
+
+	AVAKAR_ATOMIC_REF_ENTRY void notify_one() noexcept
+	{
+		AVAKAR_ATOMIC_REF_SITE();
+		_avakar::atomic_ref::notify_one(_obj);
+	}
+
+	AVAKAR_ATOMIC_REF_ENTRY void notify_all() noexcept
+	{
+		AVAKAR_ATOMIC_REF_SITE();
+		_avakar::atomic_ref::notify_all(_obj);
+	}
+
+	AVAKAR_ATOMIC_REF_ENTRY value_type fetch_add(difference_type arg, std::memory_order order = std::memory_order_seq_cst) noexcept
+	{
+		AVAKAR_ATOMIC_REF_SITE();
 		return _avakar::atomic_ref::fetch_add(_obj, arg, order);
 	}
 
-	value_type fetch_sub(difference_type arg, std::memory_order order = std::memory_order_seq_cst) noexcept
+	template <std::memory_order order>
+	AVAKAR_ATOMIC_REF_ENTRY value_type fetch_add(difference_type arg, memory_order_t<order> = {}) noexcept
+	{
+		AVAKAR_ATOMIC_REF_SITE();
+		return _avakar::atomic_ref::fetch_add(_obj, arg, memory_order_t<order>());
+	}
+
+	AVAKAR_ATOMIC_REF_ENTRY value_type fetch_sub(difference_type arg, std::memory_order order = std::memory_order_seq_cst) noexcept
 	{
+		AVAKAR_ATOMIC_REF_SITE();
 		return _avakar::atomic_ref::fetch_sub(_obj, arg, order);
 	}
 
-	value_type fetch_and(difference_type arg, std::memory_order order = std::memory_order_seq_cst) noexcept
+	template <std::memory_order order>
+	AVAKAR_ATOMIC_REF_ENTRY value_type fetch_sub(difference_type arg, memory_order_t<order> = {}) noexcept
+	{
+		AVAKAR_ATOMIC_REF_SITE();
+		return _avakar::atomic_ref::fetch_sub(_obj, arg, memory_order_t<order>());
+	}
+
+	AVAKAR_ATOMIC_REF_ENTRY value_type fetch_max(value_type arg, std::memory_order order = std::memory_order_seq_cst) noexcept
 	{
+		AVAKAR_ATOMIC_REF_SITE();
+		return _avakar::atomic_ref::fetch_max(_obj, arg, order);
+	}
+
+	AVAKAR_ATOMIC_REF_ENTRY value_type fetch_min(value_type arg, std::memory_order order = std::memory_order_seq_cst) noexcept
+	{
+		AVAKAR_ATOMIC_REF_SITE();
+		return _avakar::atomic_ref::fetch_min(_obj, arg, order);
+	}
+
+	AVAKAR_ATOMIC_REF_ENTRY value_type fetch_and(difference_type arg, std::memory_order order = std::memory_order_seq_cst) noexcept
+	{
+		AVAKAR_ATOMIC_REF_SITE();
 		return _avakar::atomic_ref::fetch_and(_obj, arg, order);
 	}
 
-	value_type fetch_or(difference_type arg, std::memory_order order = std::memory_order_seq_cst) noexcept
+	template <std::memory_order order>
+	AVAKAR_ATOMIC_REF_ENTRY value_type fetch_and(difference_type arg, memory_order_t<order> = {}) noexcept
+	{
+		AVAKAR_ATOMIC_REF_SITE();
+		return _avakar::atomic_ref::fetch_and(_obj, arg, memory_order_t<order>());
+	}
+
+	AVAKAR_ATOMIC_REF_ENTRY value_type fetch_or(difference_type arg, std::memory_order order = std::memory_order_seq_cst) noexcept
 	{
+		AVAKAR_ATOMIC_REF_SITE();
 		return _avakar::atomic_ref::fetch_or(_obj, arg, order);
 	}
 
-	value_type fetch_xor(difference_type arg, std::memory_order order = std::memory_order_seq_cst) noexcept
+	template <std::memory_order order>
+	AVAKAR_ATOMIC_REF_ENTRY value_type fetch_or(difference_type arg, memory_order_t<order> = {}) noexcept
 	{
+		AVAKAR_ATOMIC_REF_SITE();
+		return _avakar::atomic_ref::fetch_or(_obj, arg, memory_order_t<order>());
+	}
+
+	AVAKAR_ATOMIC_REF_ENTRY value_type fetch_xor(difference_type arg, std::memory_order order = std::memory_order_seq_cst) noexcept
+	{
+		AVAKAR_ATOMIC_REF_SITE();
 		return _avakar::atomic_ref::fetch_xor(_obj, arg, order);
 	}
 
+	template <std::memory_order order>
+	AVAKAR_ATOMIC_REF_ENTRY value_type fetch_xor(difference_type arg, memory_order_t<order> = {}) noexcept
+	{
+		AVAKAR_ATOMIC_REF_SITE();
+		return _avakar::atomic_ref::fetch_xor(_obj, arg, memory_order_t<order>());
+	}
+
+	AVAKAR_ATOMIC_REF_ENTRY bool bit_test_and_set(unsigned int bit, std::memory_order order = std::memory_order_seq_cst) noexcept
+	{
+		AVAKAR_ATOMIC_REF_SITE();
+		return _avakar::atomic_ref::bit_test_and_set(_obj, bit, order);
+	}
+
+	AVAKAR_ATOMIC_REF_ENTRY bool bit_test_and_reset(unsigned int bit, std::memory_order order = std::memory_order_seq_cst) noexcept
+	{
+		AVAKAR_ATOMIC_REF_SITE();
+		return _avakar::atomic_ref::bit_test_and_reset(_obj, bit, order);
+	}
+
+	AVAKAR_ATOMIC_REF_ENTRY bool bit_test_and_complement(unsigned int bit, std::memory_order order = std::memory_order_seq_cst) noexcept
+	{
+		AVAKAR_ATOMIC_REF_SITE();
+		return _avakar::atomic_ref::bit_test_and_complement(_obj, bit, order);
+	}
+
+private:
+	alignas(required_alignment) value_type _obj;
+};
+
+template <typename T>
+struct _atomic<T, std::enable_if_t<std::is_floating_point<T>::value>>
+{
+	static_assert(std::is_trivially_copyable<T>::value, "T must be TriviallyCopyable");
+
+	static constexpr bool is_always_lock_free = _avakar::atomic_ref::is_always_lock_free<T>::value;
+	static constexpr bool is_always_wait_free = _avakar::atomic_ref::is_always_wait_free<T>::value;
+	static constexpr std::size_t required_alignment = _avakar::atomic_ref::required_alignment<T>::value;
+
+	using value_type = T;
+	using difference_type = T;
+
+	_atomic() noexcept = default;
+	_atomic(_atomic const &) = delete;
+	_atomic & operator=(_atomic const &) = delete;
+
+	_atomic(T desired) noexcept
+		: _obj(desired)
+	{
+	}
+
+	bool is_lock_free() const noexcept
+	{
+		return _avakar::atomic_ref::is_lock_free<value_type>();
+	}
+
+	AVAKAR_ATOMIC_REF_ENTRY value_type load(std::memory_order order = std::memory_order_seq_cst) const noexcept
+	{
+		AVAKAR_ATOMIC_REF_SITE();
+		return _avakar::atomic_ref::load(_obj, order);
+	}
+
+	template <std::memory_order order>
+	AVAKAR_ATOMIC_REF_ENTRY value_type load(memory_order_t<order> = {}) const noexcept
+	{
+		AVAKAR_ATOMIC_REF_SITE();
+		return _avakar::atomic_ref::load(_obj, memory_order_t<order>());
+	}
+
+	AVAKAR_ATOMIC_REF_ENTRY void store(value_type desired, std::memory_order order = std::memory_order_seq_cst) noexcept
+	{
+		AVAKAR_ATOMIC_REF_SITE();
+		_avakar::atomic_ref::store(_obj, desired, order);
+	}
+
+	template <std::memory_order order>
+	AVAKAR_ATOMIC_REF_ENTRY void store(value_type desired, memory_order_t<order> = {}) noexcept
+	{
+		AVAKAR_ATOMIC_REF_SITE();
+		_avakar::atomic_ref::store(_obj, desired, memory_order_t<order>());
+	}
+
+	AVAKAR_ATOMIC_REF_ENTRY value_type exchange(value_type desired, std::memory_order order = std::memory_order_seq_cst) noexcept
+	{
+		AVAKAR_ATOMIC_REF_SITE();
+		return _avakar::atomic_ref::exchange(_obj, desired, order);
+	}
+
+	template <std::memory_order order>
+	AVAKAR_ATOMIC_REF_ENTRY value_type exchange(value_type desired, memory_order_t<order> = {}) noexcept
+	{
+		AVAKAR_ATOMIC_REF_SITE();
+		return _avakar::atomic_ref::exchange(_obj, desired, memory_order_t<order>());
+	}
+
+	AVAKAR_ATOMIC_REF_ENTRY bool compare_exchange_weak(value_type & expected, value_type desired, std::memory_order order = std::memory_order_seq_cst) noexcept
+	{
+		AVAKAR_ATOMIC_REF_SITE();
+		return this->compare_exchange_weak(expected, desired, order, order);
+	}
+
+	template <std::memory_order order>
+	AVAKAR_ATOMIC_REF_ENTRY bool compare_exchange_weak(value_type & expected, value_type desired, memory_order_t<order> = {}) noexcept
+	{
+		AVAKAR_ATOMIC_REF_SITE();
+		return _avakar::atomic_ref::_record_cas(_avakar::atomic_ref::compare_exchange_weak(_obj, expected, desired, memory_order_t<order>(), _failure_order_t<order>()));
+	}
+
+	AVAKAR_ATOMIC_REF_ENTRY bool compare_exchange_weak(
+		value_type & expected, value_type desired,
+		std::memory_order success,
+		std::memory_order failure) noexcept
+	{
+		AVAKAR_ATOMIC_REF_SITE();
+		return _avakar::atomic_ref::_record_cas(_avakar::atomic_ref::compare_exchange_weak(_obj, expected, desired, success, failure));
+	}
+
+	template <std::memory_order success, std::memory_order failure>
+	AVAKAR_ATOMIC_REF_ENTRY bool compare_exchange_weak(
+		value_type & expected, value_type desired,
+		memory_order_t<success> = {},
+		memory_order_t<failure> = {}) noexcept
+	{
+		AVAKAR_ATOMIC_REF_SITE();
+		return _avakar::atomic_ref::_record_cas(_avakar::atomic_ref::compare_exchange_weak(_obj, expected, desired, memory_order_t<success>(), memory_order_t<failure>()));
+	}
+
+	AVAKAR_ATOMIC_REF_ENTRY bool compare_exchange_strong(value_type & expected, value_type desired, std::memory_order order = std::memory_order_seq_cst) noexcept
+	{
+		AVAKAR_ATOMIC_REF_SITE();
+		return this->compare_exchange_strong(expected, desired, order, order);
+	}
+
+	template <std::memory_order order>
+	AVAKAR_ATOMIC_REF_ENTRY bool compare_exchange_strong(value_type & expected, value_type desired, memory_order_t<order> = {}) noexcept
+	{
+		AVAKAR_ATOMIC_REF_SITE();
+		return _avakar::atomic_ref::_record_cas(_avakar::atomic_ref::compare_exchange_strong(_obj, expected, desired, memory_order_t<order>(), _failure_order_t<order>()));
+	}
+
+	AVAKAR_ATOMIC_REF_ENTRY bool compare_exchange_strong(
+		value_type & expected, value_type desired,
+		std::memory_order success,
+		std::memory_order failure) noexcept
+	{
+		AVAKAR_ATOMIC_REF_SITE();
+		return _avakar::atomic_ref::_record_cas(_avakar::atomic_ref::compare_exchange_strong(_obj, expected, desired, success, failure));
+	}
+
+	template <std::memory_order success, std::memory_order failure>
+	AVAKAR_ATOMIC_REF_ENTRY bool compare_exchange_strong(
+		value_type & expected, value_type desired,
+		memory_order_t<success> = {},
+		memory_order_t<failure> = {}) noexcept
+	{
+		AVAKAR_ATOMIC_REF_SITE();
+		return _avakar::atomic_ref::_record_cas(_avakar::atomic_ref::compare_exchange_strong(_obj, expected, desired, memory_order_t<success>(), memory_order_t<failure>()));
+	}
+
+	AVAKAR_ATOMIC_REF_ENTRY void wait(value_type old, std::memory_order order = std::memory_order_seq_cst) const noexcept
+	{
+		AVAKAR_ATOMIC_REF_SITE();
+		_avakar::atomic_ref::wait(_obj, old, order);
+	}
+
+	AVAKAR_ATOMIC_REF_ENTRY void notify_one() noexcept
+	{
+		AVAKAR_ATOMIC_REF_SITE();
+		_avakar::atomic_ref::notify_one(_obj);
+	}
+
+	AVAKAR_ATOMIC_REF_ENTRY void notify_all() noexcept
+	{
+		AVAKAR_ATOMIC_REF_SITE();
+		_avakar::atomic_ref::notify_all(_obj);
+	}
+
+	AVAKAR_ATOMIC_REF_ENTRY value_type fetch_add(difference_type arg, std::memory_order order = std::memory_order_seq_cst) noexcept
+	{
+		AVAKAR_ATOMIC_REF_SITE();
+		return _avakar::atomic_ref::fetch_add(_obj, arg, order);
+	}
+
+	template <std::memory_order order>
+	AVAKAR_ATOMIC_REF_ENTRY value_type fetch_add(difference_type arg, memory_order_t<order> = {}) noexcept
+	{
+		AVAKAR_ATOMIC_REF_SITE();
+		return _avakar::atomic_ref::fetch_add(_obj, arg, memory_order_t<order>());
+	}
+
+	AVAKAR_ATOMIC_REF_ENTRY value_type fetch_sub(difference_type arg, std::memory_order order = std::memory_order_seq_cst) noexcept
+	{
+		AVAKAR_ATOMIC_REF_SITE();
+		return _avakar::atomic_ref::fetch_sub(_obj, arg, order);
+	}
+
+	template <std::memory_order order>
+	AVAKAR_ATOMIC_REF_ENTRY value_type fetch_sub(difference_type arg, memory_order_t<order> = {}) noexcept
+	{
+		AVAKAR_ATOMIC_REF_SITE();
+		return _avakar::atomic_ref::fetch_sub(_obj, arg, memory_order_t<order>());
+	}
+
+	AVAKAR_ATOMIC_REF_ENTRY value_type fetch_max(value_type arg, std::memory_order order = std::memory_order_seq_cst) noexcept
+	{
+		AVAKAR_ATOMIC_REF_SITE();
+		return _avakar::atomic_ref::fetch_max(_obj, arg, order);
+	}
+
+	AVAKAR_ATOMIC_REF_ENTRY value_type fetch_min(value_type arg, std::memory_order order = std::memory_order_seq_cst) noexcept
+	{
+		AVAKAR_ATOMIC_REF_SITE();
+		return _avakar::atomic_ref::fetch_min(_obj, arg, order);
+	}
+
 private:
-	value_type _obj;
+	alignas(required_alignment) value_type _obj;
 };
 
 }
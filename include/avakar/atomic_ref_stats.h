@@ -0,0 +1,134 @@
+#ifndef AVAKAR_ATOMIC_REF_STATS_h
+#define AVAKAR_ATOMIC_REF_STATS_h
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+#include "atomic_ref.h"
+
+namespace avakar {
+
+// Per-call-site contention counters, collected when the translation units
+// are compiled with `AVAKAR_ATOMIC_REF_INSTRUMENT` defined. Otherwise,
+// the functions below report nothing.
+//
+// A site is a code address just past the instrumented operation; resolve it
+// with `addr2line -e <binary>` after subtracting the load address of
+// the module. Events from sites that didn't fit into a thread's table are
+// reported under a null site.
+
+struct atomic_ref_site_stats
+{
+	void const * site;
+	std::uint64_t cas_failures;
+	std::uint64_t retries;
+	std::uint64_t waits;
+	std::uint64_t notifies;
+};
+
+#ifndef AVAKAR_ATOMIC_REF_INSTRUMENT
+
+inline std::vector<atomic_ref_site_stats> atomic_ref_stats()
+{
+	return {};
+}
+
+inline void reset_atomic_ref_stats() noexcept
+{
+}
+
+#else
+
+// Returns the counters summed over all threads, the most contended sites
+// first. The counts of running threads may be slightly stale.
+inline std::vector<atomic_ref_site_stats> atomic_ref_stats()
+{
+	namespace impl = _avakar::atomic_ref;
+
+	std::vector<atomic_ref_site_stats> r;
+
+	impl::_site_table * table = impl::_site_registry<>::head.load(std::memory_order_acquire);
+	for (; table != nullptr; table = table->next)
+	{
+		for (std::size_t idx = 0; idx <= impl::_site_table::capacity; ++idx)
+		{
+			impl::_site_counters const & c = table->sites[idx];
+
+			// The overflow bucket has no site of its own.
+			void const * site = nullptr;
+			if (idx != impl::_site_table::capacity)
+			{
+				site = c.site.load(std::memory_order_acquire);
+				if (site == nullptr)
+					continue;
+			}
+
+			std::uint64_t counts[impl::event_count];
+			for (std::size_t i = 0; i != impl::event_count; ++i)
+				counts[i] = c.counts[i].load(std::memory_order_relaxed);
+
+			auto it = r.begin();
+			while (it != r.end() && it->site != site)
+				++it;
+			if (it == r.end())
+				it = r.insert(it, atomic_ref_site_stats{ site, 0, 0, 0, 0 });
+
+			it->cas_failures += counts[static_cast<std::size_t>(impl::event::cas_failure)];
+			it->retries += counts[static_cast<std::size_t>(impl::event::retry)];
+			it->waits += counts[static_cast<std::size_t>(impl::event::wait)];
+			it->notifies += counts[static_cast<std::size_t>(impl::event::notify)];
+		}
+	}
+
+	auto total = [](atomic_ref_site_stats const & s) {
+		return s.cas_failures + s.retries + s.waits + s.notifies;
+	};
+
+	r.erase(std::remove_if(r.begin(), r.end(), [&](atomic_ref_site_stats const & s) {
+		return total(s) == 0;
+	}), r.end());
+
+	std::sort(r.begin(), r.end(), [&](atomic_ref_site_stats const & lhs, atomic_ref_site_stats const & rhs) {
+		return total(lhs) > total(rhs);
+	});
+
+	return r;
+}
+
+// Zeroes the counters of all threads. Events recorded concurrently
+// with the reset may be lost.
+inline void reset_atomic_ref_stats() noexcept
+{
+	namespace impl = _avakar::atomic_ref;
+
+	impl::_site_table * table = impl::_site_registry<>::head.load(std::memory_order_acquire);
+	for (; table != nullptr; table = table->next)
+	{
+		for (impl::_site_counters & c: table->sites)
+		{
+			for (std::atomic<std::uint64_t> & count: c.counts)
+				count.store(0, std::memory_order_relaxed);
+		}
+	}
+}
+
+#endif
+
+inline void dump_atomic_ref_stats(std::FILE * fout = stderr)
+{
+	for (atomic_ref_site_stats const & s: atomic_ref_stats())
+	{
+		std::fprintf(fout, "%p: cas_failures=%llu retries=%llu waits=%llu notifies=%llu\n",
+			s.site,
+			(unsigned long long)s.cas_failures,
+			(unsigned long long)s.retries,
+			(unsigned long long)s.waits,
+			(unsigned long long)s.notifies);
+	}
+}
+
+}
+
+#endif // _h
@@ -0,0 +1,232 @@
+#ifndef AVAKAR_ATOMIC_TAGGED_PTR_h
+#define AVAKAR_ATOMIC_TAGGED_PTR_h
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+#include "atomic_ref.h"
+
+// A pointer and a generation counter packed into a single word.
+//
+// On 64-bit x86 and ARM, user-space addresses fit into the low 48 bits
+// and the tag occupies the high 16. This assumes that the high bits
+// of every pointer are zero. Define `AVAKAR_TAGGED_PTR_ADDRESS_BITS`
+// to change the split, e.g. to 57 if your process maps memory above
+// 2^47 under 5-level paging (LA57). On ARM, pointers may carry a tag
+// in their top byte, e.g. under MTE or HWASan; define the macro to 0
+// to move the tag to the low bits, as on other targets. Debug builds
+// assert that pointers don't overlap the tag.
+//
+// Elsewhere, the tag lives in the low bits that are always zero due
+// to alignment; the `align` parameter may promise more alignment than
+// `alignof(T)` to get a wider tag.
+//
+// Either way the tag is narrow and wraps around, so it makes ABA
+// unlikely rather than impossible: a thread would have to be preempted
+// between its load and its CAS while the tag goes through a full cycle.
+
+#if !defined(AVAKAR_TAGGED_PTR_ADDRESS_BITS) && (defined(__x86_64__) || defined(_M_AMD64) || defined(__aarch64__) || defined(_M_ARM64))
+#define AVAKAR_TAGGED_PTR_ADDRESS_BITS 48
+#endif
+
+namespace avakar {
+
+template <typename T, std::size_t align = alignof(T)>
+struct tagged_ptr
+{
+	static_assert((align & (align - 1)) == 0 && align >= alignof(T), "align must be a power of two not less than alignof(T)");
+
+private:
+	static constexpr unsigned _log2(std::size_t n) noexcept
+	{
+		return n <= 1? 0: 1 + _log2(n / 2);
+	}
+
+public:
+#if defined(AVAKAR_TAGGED_PTR_ADDRESS_BITS) && AVAKAR_TAGGED_PTR_ADDRESS_BITS != 0
+	static constexpr unsigned tag_bits = sizeof(std::uintptr_t) * 8 - AVAKAR_TAGGED_PTR_ADDRESS_BITS;
+	static constexpr unsigned tag_shift = AVAKAR_TAGGED_PTR_ADDRESS_BITS;
+#else
+	static constexpr unsigned tag_bits = _log2(align);
+	static constexpr unsigned tag_shift = 0;
+#endif
+
+	static_assert(tag_bits != 0, "there are no spare bits for the tag, increase align");
+
+	static constexpr std::uintptr_t tag_mask = ((std::uintptr_t(1) << tag_bits) - 1) << tag_shift;
+
+	constexpr tagged_ptr() noexcept
+		: _word(0)
+	{
+	}
+
+	explicit tagged_ptr(T * ptr, std::uintptr_t tag = 0) noexcept
+		: _word(reinterpret_cast<std::uintptr_t>(ptr) | ((tag << tag_shift) & tag_mask))
+	{
+		assert((reinterpret_cast<std::uintptr_t>(ptr) & tag_mask) == 0 && "the pointer overlaps the tag");
+	}
+
+	static constexpr tagged_ptr from_word(std::uintptr_t word) noexcept
+	{
+		return tagged_ptr(word, 0);
+	}
+
+	constexpr std::uintptr_t word() const noexcept
+	{
+		return _word;
+	}
+
+	T * ptr() const noexcept
+	{
+		return reinterpret_cast<T *>(_word & ~tag_mask);
+	}
+
+	constexpr std::uintptr_t tag() const noexcept
+	{
+		return (_word & tag_mask) >> tag_shift;
+	}
+
+	// Returns `ptr` tagged with the successor of this tag.
+	tagged_ptr next(T * ptr) const noexcept
+	{
+		return tagged_ptr(ptr, this->tag() + 1);
+	}
+
+	T * operator->() const noexcept
+	{
+		return this->ptr();
+	}
+
+	T & operator*() const noexcept
+	{
+		return *this->ptr();
+	}
+
+	friend constexpr bool operator==(tagged_ptr const & lhs, tagged_ptr const & rhs) noexcept
+	{
+		return lhs._word == rhs._word;
+	}
+
+	friend constexpr bool operator!=(tagged_ptr const & lhs, tagged_ptr const & rhs) noexcept
+	{
+		return lhs._word != rhs._word;
+	}
+
+private:
+	constexpr tagged_ptr(std::uintptr_t word, int) noexcept
+		: _word(word)
+	{
+	}
+
+	std::uintptr_t _word;
+};
+
+// An atomic `tagged_ptr`. Successful compare-exchanges increment the tag,
+// so a pointer that was popped and pushed back in the meantime
+// no longer compares equal.
+
+template <typename T, std::size_t align = alignof(T)>
+struct atomic_tagged_ptr
+{
+	using value_type = tagged_ptr<T, align>;
+	using difference_type = std::ptrdiff_t;
+
+	static constexpr bool is_always_lock_free = _avakar::atomic_ref::is_always_lock_free<std::uintptr_t>::value;
+	static constexpr bool is_always_wait_free = _avakar::atomic_ref::is_always_wait_free<std::uintptr_t>::value;
+
+	bool is_lock_free() const noexcept
+	{
+		return _avakar::atomic_ref::is_lock_free<std::uintptr_t>();
+	}
+
+	explicit atomic_tagged_ptr() noexcept
+		: _obj(0)
+	{
+	}
+
+	explicit atomic_tagged_ptr(T * desired) noexcept
+		: _obj(value_type(desired).word())
+	{
+	}
+
+	explicit atomic_tagged_ptr(value_type desired) noexcept
+		: _obj(desired.word())
+	{
+	}
+
+	atomic_tagged_ptr(atomic_tagged_ptr const &) = delete;
+	atomic_tagged_ptr & operator=(atomic_tagged_ptr const &) = delete;
+
+	value_type load(std::memory_order order = std::memory_order_seq_cst) const noexcept
+	{
+		return value_type::from_word(_avakar::atomic_ref::load(_obj, order));
+	}
+
+	void store(value_type desired, std::memory_order order = std::memory_order_seq_cst) noexcept
+	{
+		_avakar::atomic_ref::store(_obj, desired.word(), order);
+	}
+
+	value_type exchange(value_type desired, std::memory_order order = std::memory_order_seq_cst) noexcept
+	{
+		return value_type::from_word(_avakar::atomic_ref::exchange(_obj, desired.word(), order));
+	}
+
+	// Replaces `expected` with `desired` tagged with the successor
+	// of `expected`'s tag.
+	bool compare_exchange_weak(value_type & expected, T * desired, std::memory_order order = std::memory_order_seq_cst) noexcept
+	{
+		return this->compare_exchange_weak(expected, desired, order, order);
+	}
+
+	bool compare_exchange_weak(
+		value_type & expected, T * desired,
+		std::memory_order success,
+		std::memory_order failure) noexcept
+	{
+		std::uintptr_t exp = expected.word();
+		bool r = _avakar::atomic_ref::_record_cas(_avakar::atomic_ref::compare_exchange_weak(_obj, exp, expected.next(desired).word(), success, failure));
+		expected = value_type::from_word(exp);
+		return r;
+	}
+
+	bool compare_exchange_strong(value_type & expected, T * desired, std::memory_order order = std::memory_order_seq_cst) noexcept
+	{
+		return this->compare_exchange_strong(expected, desired, order, order);
+	}
+
+	bool compare_exchange_strong(
+		value_type & expected, T * desired,
+		std::memory_order success,
+		std::memory_order failure) noexcept
+	{
+		std::uintptr_t exp = expected.word();
+		bool r = _avakar::atomic_ref::_record_cas(_avakar::atomic_ref::compare_exchange_strong(_obj, exp, expected.next(desired).word(), success, failure));
+		expected = value_type::from_word(exp);
+		return r;
+	}
+
+	// Moves the pointer part by `arg` elements, leaving the tag intact.
+	// The result must not leave the object the pointer points into.
+	value_type fetch_add(difference_type arg, std::memory_order order = std::memory_order_seq_cst) noexcept
+	{
+		static_assert(value_type::tag_shift != 0 || sizeof(T) % align == 0, "moving the pointer would change the tag");
+		return value_type::from_word(_avakar::atomic_ref::fetch_add(_obj, static_cast<std::uintptr_t>(arg) * sizeof(T), order));
+	}
+
+	value_type fetch_sub(difference_type arg, std::memory_order order = std::memory_order_seq_cst) noexcept
+	{
+		static_assert(value_type::tag_shift != 0 || sizeof(T) % align == 0, "moving the pointer would change the tag");
+		return value_type::from_word(_avakar::atomic_ref::fetch_sub(_obj, static_cast<std::uintptr_t>(arg) * sizeof(T), order));
+	}
+
+private:
+	alignas(_avakar::atomic_ref::required_alignment<std::uintptr_t>::value) std::uintptr_t _obj;
+};
+
+}
+
+#endif // _h
@@ -0,0 +1,134 @@
+#ifndef AVAKAR_BACKOFF_h
+#define AVAKAR_BACKOFF_h
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+
+#include "atomic_ref.h"
+
+namespace avakar {
+
+// Tells the CPU that the thread is spinning, e.g. with `pause` on x86.
+inline void cpu_relax() noexcept
+{
+	_avakar::atomic_ref::cpu_relax();
+}
+
+// Exponential backoff for spin loops. Each call spins for twice as long
+// as the previous one, up to `limit` iterations of `cpu_relax`.
+struct exponential_backoff
+{
+	explicit exponential_backoff(unsigned limit = 64) noexcept
+		: _cur(1), _limit(limit)
+	{
+	}
+
+	void operator()() noexcept
+	{
+		for (unsigned i = 0; i != _cur; ++i)
+			cpu_relax();
+
+		if (_cur < _limit)
+			_cur *= 2;
+	}
+
+	bool saturated() const noexcept
+	{
+		return _cur >= _limit;
+	}
+
+	void reset() noexcept
+	{
+		_cur = 1;
+	}
+
+private:
+	unsigned _cur;
+	unsigned _limit;
+};
+
+// Backoff policies for `fetch_update` in <avakar/fetch_update.h>,
+// along with `exponential_backoff`. A policy is default-constructed
+// for each update and called after each failed CAS.
+
+struct no_backoff
+{
+	void operator()() noexcept
+	{
+	}
+};
+
+struct pause_backoff
+{
+	void operator()() noexcept
+	{
+		cpu_relax();
+	}
+};
+
+// Like `exponential_backoff`, but spins for a random number of iterations
+// up to the current limit, so that threads that collided once don't
+// collide again in lockstep.
+struct jittered_backoff
+{
+	explicit jittered_backoff(unsigned limit = 64) noexcept
+		: _cur(1), _limit(limit), _rand(_seed())
+	{
+	}
+
+	void operator()() noexcept
+	{
+		// xorshift32
+		_rand ^= _rand << 13;
+		_rand ^= _rand >> 17;
+		_rand ^= _rand << 5;
+
+		for (unsigned i = 0, n = 1 + _rand % _cur; i != n; ++i)
+			cpu_relax();
+
+		if (_cur < _limit)
+			_cur *= 2;
+	}
+
+private:
+	std::uint32_t _seed() const noexcept
+	{
+		// The object is usually on the stack of its thread.
+		std::uint32_t seed = static_cast<std::uint32_t>(reinterpret_cast<std::uintptr_t>(this) >> 4);
+		return seed * 2654435761u | 1;
+	}
+
+	unsigned _cur;
+	unsigned _limit;
+	std::uint32_t _rand;
+};
+
+struct yield_backoff
+{
+	void operator()() noexcept
+	{
+		std::this_thread::yield();
+	}
+};
+
+// Returns once `obj` no longer holds `old`. Spins with exponential backoff
+// first, as the value often changes soon, and only then blocks
+// in `obj.wait`.
+template <typename Atomic, typename T>
+void spin_wait(Atomic const & obj, T old, std::memory_order order = std::memory_order_seq_cst) noexcept
+{
+	exponential_backoff backoff;
+	while (!backoff.saturated())
+	{
+		if (obj.load(order) != old)
+			return;
+		backoff();
+	}
+
+	obj.wait(old, order);
+}
+
+}
+
+#endif // _h
@@ -0,0 +1,105 @@
+#ifndef AVAKAR_BARRIER_h
+#define AVAKAR_BARRIER_h
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+#include "atomic.h"
+#include "backoff.h"
+
+namespace avakar {
+
+struct _empty_completion
+{
+	void operator()() noexcept
+	{
+	}
+};
+
+// A reusable thread barrier, like C++20's `std::barrier`.
+//
+// Threads count down the number of remaining arrivals; the last one
+// runs the completion function, resets the count and flips the phase,
+// which is what the other threads wait on. Only the phase counter's
+// parity matters to the waiters, so this is a sense-reversing barrier
+// that doesn't need a per-thread sense.
+
+template <typename CompletionFunction = _empty_completion>
+struct barrier
+{
+	struct arrival_token
+	{
+	private:
+		explicit arrival_token(std::uint32_t phase) noexcept
+			: _phase(phase)
+		{
+		}
+
+		std::uint32_t _phase;
+
+		friend barrier;
+	};
+
+	static constexpr std::ptrdiff_t max() noexcept
+	{
+		return INT32_MAX;
+	}
+
+	explicit barrier(std::ptrdiff_t expected, CompletionFunction f = CompletionFunction())
+		: _remaining(static_cast<std::int32_t>(expected)),
+		_expected(static_cast<std::int32_t>(expected)),
+		_phase(0),
+		_completion(std::move(f))
+	{
+	}
+
+	barrier(barrier const &) = delete;
+	barrier & operator=(barrier const &) = delete;
+
+	arrival_token arrive(std::ptrdiff_t n = 1)
+	{
+		// The phase can't flip before this thread arrives.
+		std::uint32_t phase = _phase.load(std::memory_order_relaxed);
+
+		std::int32_t prev = _remaining.fetch_sub(static_cast<std::int32_t>(n), std::memory_order_acq_rel);
+		if (prev == n)
+		{
+			_completion();
+			_remaining.store(_expected.load(std::memory_order_relaxed), std::memory_order_relaxed);
+			_phase.store(phase + 1, std::memory_order_release);
+			_phase.notify_all();
+		}
+
+		return arrival_token(phase);
+	}
+
+	void wait(arrival_token && token) const noexcept
+	{
+		while (_phase.load(std::memory_order_acquire) == token._phase)
+			spin_wait(_phase, token._phase, std::memory_order_acquire);
+	}
+
+	void arrive_and_wait()
+	{
+		this->wait(this->arrive());
+	}
+
+	// Arrives and removes the thread from the subsequent phases.
+	void arrive_and_drop()
+	{
+		_expected.fetch_sub(1, std::memory_order_relaxed);
+		this->arrive();
+	}
+
+private:
+	atomic<std::int32_t> _remaining;
+	atomic<std::int32_t> _expected;
+	atomic<std::uint32_t> _phase;
+	CompletionFunction _completion;
+};
+
+}
+
+#endif // _h
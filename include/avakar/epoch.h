@@ -0,0 +1,335 @@
+#ifndef AVAKAR_EPOCH_h
+#define AVAKAR_EPOCH_h
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "atomic.h"
+#include "padded_atomic.h"
+
+namespace avakar {
+
+// Epoch-based reclamation.
+//
+// Readers wrap their accesses to shared objects in critical sections,
+// which merely publish the current global epoch in the thread's record.
+// Writers retire unlinked objects into per-thread limbo lists tagged
+// with the epoch. The global epoch advances once every thread inside
+// a critical section has observed it, so an object retired in epoch `e`
+// can be freed once the global epoch reaches `e + 2`.
+//
+// Unlike hazard pointers, readers don't protect individual objects,
+// which makes them cheaper, but a reader stalled inside a critical section
+// holds back the reclamation of all objects.
+//
+//     avakar::epoch_participant & self = avakar::this_thread_epoch_participant();
+//
+//     {
+//         avakar::epoch_guard guard(self);
+//         config const * cfg = current_config.load();
+//         ...
+//     }
+//
+//     self.retire(current_config.exchange(new_cfg));
+
+struct _epoch_retired
+{
+	void * ptr;
+	void (*reclaim)(void * ptr);
+};
+
+struct _epoch_limbo
+{
+	std::uint64_t epoch;
+	std::vector<_epoch_retired> objs;
+};
+
+struct _epoch_orphan
+{
+	_epoch_orphan * next;
+	_epoch_limbo limbo;
+};
+
+struct _epoch_record
+{
+	// Twice the epoch the thread is in, plus one; zero if the thread
+	// is outside of critical sections.
+	padded_atomic<std::uint64_t> local;
+	atomic<bool> active;
+	_epoch_record * next;
+};
+
+struct epoch_domain
+{
+	explicit epoch_domain() noexcept
+		: _global(0), _records(), _orphans()
+	{
+	}
+
+	epoch_domain(epoch_domain const &) = delete;
+	epoch_domain & operator=(epoch_domain const &) = delete;
+
+	// Reclaims all retired objects. The domain must not be in use.
+	~epoch_domain()
+	{
+		_epoch_orphan * orphan = _orphans.load(std::memory_order_acquire);
+		while (orphan != nullptr)
+		{
+			_epoch_orphan * next = orphan->next;
+			_free(orphan->limbo);
+			delete orphan;
+			orphan = next;
+		}
+
+		_epoch_record * rec = _records.load(std::memory_order_acquire);
+		while (rec != nullptr)
+		{
+			_epoch_record * next = rec->next;
+			_delete_aligned(rec);
+			rec = next;
+		}
+	}
+
+	std::uint64_t epoch() const noexcept
+	{
+		return _global.load(std::memory_order_acquire);
+	}
+
+	// Advances the global epoch if all threads in critical sections
+	// have observed the current one. Returns the global epoch.
+	std::uint64_t try_advance() noexcept
+	{
+		std::uint64_t e = _global.load(std::memory_order_relaxed);
+
+		// Pairs with the fence in `enter`.
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+
+		for (_epoch_record * rec = _records.load(std::memory_order_acquire); rec != nullptr; rec = rec->next)
+		{
+			// Acquire pairs with the release in `leave`, so that a thread's
+			// accesses in its past critical sections happen before
+			// the reclamation.
+			std::uint64_t local = rec->local.load(std::memory_order_acquire);
+			if (local != 0 && local != 2 * e + 1)
+				return e;
+		}
+
+		if (_global.compare_exchange_strong(e, e + 1, std::memory_order_acq_rel, std::memory_order_relaxed))
+			++e;
+
+		this->_reclaim_orphans(e);
+		return e;
+	}
+
+	std::uint64_t _epoch_relaxed() const noexcept
+	{
+		return _global.load(std::memory_order_relaxed);
+	}
+
+	_epoch_record * _acquire()
+	{
+		for (_epoch_record * rec = _records.load(std::memory_order_acquire); rec != nullptr; rec = rec->next)
+		{
+			bool active = false;
+			if (!rec->active.load(std::memory_order_relaxed)
+				&& rec->active.compare_exchange_strong(active, true, std::memory_order_acquire, std::memory_order_relaxed))
+			{
+				return rec;
+			}
+		}
+
+		_epoch_record * rec = _new_aligned<_epoch_record>();
+		rec->active.store(true, std::memory_order_relaxed);
+
+		_epoch_record * head = _records.load(std::memory_order_relaxed);
+		do
+			rec->next = head;
+		while (!_records.compare_exchange_weak(head, rec, std::memory_order_release, std::memory_order_relaxed));
+
+		return rec;
+	}
+
+	void _release(_epoch_record * rec) noexcept
+	{
+		rec->local.store(0, std::memory_order_release);
+		rec->active.store(false, std::memory_order_release);
+	}
+
+	// Takes over the limbo list of a departing participant.
+	void _adopt(_epoch_limbo && limbo)
+	{
+		_epoch_orphan * orphan = new _epoch_orphan{ nullptr, std::move(limbo) };
+
+		_epoch_orphan * head = _orphans.load(std::memory_order_relaxed);
+		do
+			orphan->next = head;
+		while (!_orphans.compare_exchange_weak(head, orphan, std::memory_order_release, std::memory_order_relaxed));
+	}
+
+	static void _free(_epoch_limbo & limbo) noexcept
+	{
+		for (_epoch_retired const & obj: limbo.objs)
+			obj.reclaim(obj.ptr);
+		limbo.objs.clear();
+	}
+
+private:
+	void _reclaim_orphans(std::uint64_t e)
+	{
+		if (_orphans.load(std::memory_order_relaxed) == nullptr)
+			return;
+
+		_epoch_orphan * orphan = _orphans.exchange(nullptr, std::memory_order_acquire);
+		while (orphan != nullptr)
+		{
+			_epoch_orphan * next = orphan->next;
+			if (orphan->limbo.epoch + 2 <= e)
+			{
+				_free(orphan->limbo);
+				delete orphan;
+			}
+			else
+			{
+				this->_adopt(std::move(orphan->limbo));
+				delete orphan;
+			}
+
+			orphan = next;
+		}
+	}
+
+	atomic<std::uint64_t> _global;
+	atomic<_epoch_record *> _records;
+	atomic<_epoch_orphan *> _orphans;
+};
+
+inline epoch_domain & default_epoch_domain() noexcept
+{
+	static epoch_domain domain;
+	return domain;
+}
+
+// A thread's membership in a domain. A participant must only be used
+// by one thread at a time.
+struct epoch_participant
+{
+	explicit epoch_participant(epoch_domain & domain = default_epoch_domain())
+		: _domain(domain), _rec(domain._acquire()), _nesting(0), _retired(0), _limbo()
+	{
+	}
+
+	epoch_participant(epoch_participant const &) = delete;
+	epoch_participant & operator=(epoch_participant const &) = delete;
+
+	~epoch_participant()
+	{
+		_domain._release(_rec);
+		for (_epoch_limbo & limbo: _limbo)
+		{
+			if (!limbo.objs.empty())
+				_domain._adopt(std::move(limbo));
+		}
+	}
+
+	// Starts a critical section. Critical sections may nest.
+	void enter() noexcept
+	{
+		if (_nesting++ != 0)
+			return;
+
+		std::uint64_t e = _domain._epoch_relaxed();
+		_rec->local.store(2 * e + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+	}
+
+	void leave() noexcept
+	{
+		if (--_nesting == 0)
+			_rec->local.store(0, std::memory_order_release);
+	}
+
+	bool in_critical_section() const noexcept
+	{
+		return _nesting != 0;
+	}
+
+	// Schedules `ptr` to be deleted once no critical section
+	// can still reference it.
+	template <typename T>
+	void retire(T * ptr)
+	{
+		this->retire(static_cast<void *>(ptr), [](void * p) { delete static_cast<T *>(p); });
+	}
+
+	void retire(void * ptr, void (*reclaim)(void * ptr))
+	{
+		std::uint64_t e = _domain.epoch();
+
+		_epoch_limbo & limbo = _limbo[e % 3];
+		if (limbo.epoch != e)
+		{
+			// The bucket was last used three or more epochs ago.
+			epoch_domain::_free(limbo);
+			limbo.epoch = e;
+		}
+
+		limbo.objs.push_back(_epoch_retired{ ptr, reclaim });
+
+		if (++_retired % _advance_interval == 0)
+			this->try_reclaim();
+	}
+
+	// Tries to advance the epoch and frees whatever it can. This happens
+	// automatically as objects are retired.
+	void try_reclaim()
+	{
+		std::uint64_t e = _domain.try_advance();
+		for (_epoch_limbo & limbo: _limbo)
+		{
+			if (limbo.epoch + 2 <= e)
+				epoch_domain::_free(limbo);
+		}
+	}
+
+private:
+	static constexpr std::size_t _advance_interval = 64;
+
+	epoch_domain & _domain;
+	_epoch_record * _rec;
+	std::size_t _nesting;
+	std::size_t _retired;
+	_epoch_limbo _limbo[3];
+};
+
+// The calling thread's participant in the default domain.
+inline epoch_participant & this_thread_epoch_participant()
+{
+	static thread_local epoch_participant participant;
+	return participant;
+}
+
+struct epoch_guard
+{
+	explicit epoch_guard(epoch_participant & participant = this_thread_epoch_participant()) noexcept
+		: _participant(participant)
+	{
+		_participant.enter();
+	}
+
+	epoch_guard(epoch_guard const &) = delete;
+	epoch_guard & operator=(epoch_guard const &) = delete;
+
+	~epoch_guard()
+	{
+		_participant.leave();
+	}
+
+private:
+	epoch_participant & _participant;
+};
+
+}
+
+#endif // _h
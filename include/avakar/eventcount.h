@@ -0,0 +1,124 @@
+#ifndef AVAKAR_EVENTCOUNT_h
+#define AVAKAR_EVENTCOUNT_h
+
+#include <atomic>
+#include <cstdint>
+
+#include "atomic.h"
+#include "backoff.h"
+
+namespace avakar {
+
+// An eventcount, for adding blocking to lock-free data structures.
+//
+// A 64-bit word holds an epoch in the high half and the number of parked
+// threads in the low half. A consumer that finds nothing to do registers
+// as a waiter and takes the current epoch as its key, re-checks its
+// condition, and then either cancels or waits for the epoch to move past
+// the key. Producers change the data structure and then call `notify`,
+// which bumps the epoch and wakes the waiters only if there are some;
+// otherwise it costs a fence and a relaxed load.
+//
+// A notification is a broadcast: every waiter whose key predates it
+// returns from `commit_wait` and re-checks its condition. There's no
+// way to wake just one, since all of them wait for the same epoch.
+//
+//     for (;;)
+//     {
+//         if (q.try_pop(value))
+//             break;
+//
+//         auto key = ec.prepare_wait();
+//         if (q.try_pop(value))
+//         {
+//             ec.cancel_wait();
+//             break;
+//         }
+//
+//         ec.commit_wait(key);
+//     }
+//
+//     // producer
+//     q.try_push(value);
+//     ec.notify();
+
+struct eventcount
+{
+	struct key
+	{
+	private:
+		explicit key(std::uint32_t epoch) noexcept
+			: _epoch(epoch)
+		{
+		}
+
+		std::uint32_t _epoch;
+
+		friend eventcount;
+	};
+
+	explicit eventcount() noexcept
+		: _state(0)
+	{
+	}
+
+	eventcount(eventcount const &) = delete;
+	eventcount & operator=(eventcount const &) = delete;
+
+	// Registers the calling thread as a waiter. The caller must re-check
+	// its condition afterwards and then call either `cancel_wait`
+	// or `commit_wait`.
+	key prepare_wait() noexcept
+	{
+		// Seq-cst orders the registration before the caller's re-check;
+		// pairs with the fence in `notify`.
+		std::uint64_t prev = _state.fetch_add(_waiter, std::memory_order_seq_cst);
+		return key(static_cast<std::uint32_t>(prev >> _epoch_shift));
+	}
+
+	void cancel_wait() noexcept
+	{
+		_state.fetch_sub(_waiter, std::memory_order_relaxed);
+	}
+
+	// Blocks until a `notify` after the matching `prepare_wait`.
+	void commit_wait(key k) noexcept
+	{
+		for (;;)
+		{
+			std::uint64_t cur = _state.load(std::memory_order_acquire);
+			if (static_cast<std::uint32_t>(cur >> _epoch_shift) != k._epoch)
+				break;
+
+			// Wakes up spuriously when other waiters come and go.
+			spin_wait(_state, cur, std::memory_order_acquire);
+		}
+
+		_state.fetch_sub(_waiter, std::memory_order_relaxed);
+	}
+
+	// Wakes all waiters.
+	void notify() noexcept
+	{
+		// Orders the caller's changes before the check for waiters;
+		// a waiter either sees the changes in its re-check or is seen here.
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if ((_state.load(std::memory_order_relaxed) & _waiters) == 0)
+			return;
+
+		_state.fetch_add(_epoch, std::memory_order_release);
+		_state.notify_all();
+	}
+
+private:
+	static constexpr int _epoch_shift = 32;
+	static constexpr std::uint64_t _waiter = 1;
+	static constexpr std::uint64_t _epoch = std::uint64_t(1) << _epoch_shift;
+	static constexpr std::uint64_t _waiters = _epoch - 1;
+
+	atomic<std::uint64_t> _state;
+};
+
+}
+
+#endif // _h
@@ -0,0 +1,69 @@
+#ifndef AVAKAR_FETCH_UPDATE_h
+#define AVAKAR_FETCH_UPDATE_h
+
+#include <atomic>
+#include <type_traits>
+
+#include "backoff.h"
+#include "memory_order.h"
+
+namespace avakar {
+
+// Read-modify-write with an arbitrary transform, for `atomic` and
+// `atomic_ref`. Kept out of the core headers together with the backoff
+// policies it depends on.
+//
+//     auto r = avakar::fetch_update(counter, [](std::uint64_t v) { return v * 3; });
+//     int hi = avakar::update_and_fetch<avakar::pause_backoff>(level,
+//         [&](int v) { return std::max(v, sample); });
+
+template <typename T>
+struct update_result
+{
+	T old_value;
+	T new_value;
+};
+
+template <typename Atomic>
+using _update_value_t = typename std::remove_cv_t<std::remove_reference_t<Atomic>>::value_type;
+
+// Replaces the value `v` of `obj` with `fn(v)` in a CAS loop, backing off
+// between the attempts as `Backoff` says. Returns both values.
+template <typename Backoff = jittered_backoff, typename Atomic, typename F>
+AVAKAR_ATOMIC_REF_ENTRY update_result<_update_value_t<Atomic>> fetch_update(
+	Atomic && obj, F fn,
+	std::memory_order success,
+	std::memory_order failure)
+{
+	AVAKAR_ATOMIC_REF_SITE();
+
+	using T = _update_value_t<Atomic>;
+
+	Backoff backoff;
+	T old = obj.load(failure);
+	for (;;)
+	{
+		T desired = fn(static_cast<T const &>(old));
+		if (obj.compare_exchange_weak(old, desired, success, failure))
+			return update_result<T>{ old, desired };
+		backoff();
+	}
+}
+
+template <typename Backoff = jittered_backoff, typename Atomic, typename F>
+AVAKAR_ATOMIC_REF_ENTRY update_result<_update_value_t<Atomic>> fetch_update(Atomic && obj, F fn, std::memory_order order = std::memory_order_seq_cst)
+{
+	AVAKAR_ATOMIC_REF_SITE();
+	return avakar::fetch_update<Backoff>(obj, fn, order, _failure_order(order));
+}
+
+template <typename Backoff = jittered_backoff, typename Atomic, typename F>
+AVAKAR_ATOMIC_REF_ENTRY _update_value_t<Atomic> update_and_fetch(Atomic && obj, F fn, std::memory_order order = std::memory_order_seq_cst)
+{
+	AVAKAR_ATOMIC_REF_SITE();
+	return avakar::fetch_update<Backoff>(obj, fn, order, _failure_order(order)).new_value;
+}
+
+}
+
+#endif // _h
@@ -0,0 +1,310 @@
+#ifndef AVAKAR_FLAT_COMBINING_h
+#define AVAKAR_FLAT_COMBINING_h
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include "atomic.h"
+#include "backoff.h"
+#include "padded_atomic.h"
+
+namespace avakar {
+
+// Flat combining, after Hendler, Incze, Shavit and Tzafrir.
+//
+// Wraps an object of type `T` that isn't thread-safe. A thread that
+// finds the combiner lock taken publishes its operation in one of
+// the `slots` publication slots, each on its own cache line, and marks
+// the lock as contended. Before the holder of the lock leaves, it applies
+// all published operations in one pass, so the object's cache lines stay
+// with one thread for the whole batch. The other threads spin on their
+// own slot and eventually block on it until the combiner marks it done.
+// Without contention, an operation costs a CAS and an exchange
+// on the lock.
+//
+// Slots are picked by the CPU the thread is running on, or by thread
+// where that can't be queried, and claimed with a CAS, so any number
+// of threads may use the wrapper.
+//
+//     avakar::flat_combining<std::priority_queue<int>> pq;
+//
+//     pq.apply([](std::priority_queue<int> & q) { q.push(42); });
+//     int top = pq.apply([](std::priority_queue<int> & q) {
+//         int r = q.top();
+//         q.pop();
+//         return r;
+//     });
+//
+// An exception thrown by an operation propagates to the thread that
+// published it. Operations must not call `apply` on the same wrapper.
+
+template <typename T, typename F, typename R>
+struct _fc_op
+{
+	static_assert(!std::is_reference<R>::value, "the operation must return by value");
+
+	explicit _fc_op(F & f) noexcept
+		: _f(f), _error()
+	{
+	}
+
+	static void invoke(void * self, T & obj) noexcept
+	{
+		_fc_op & op = *static_cast<_fc_op *>(self);
+		try
+		{
+			::new(static_cast<void *>(&op._result)) R(op._f(obj));
+		}
+		catch (...)
+		{
+			op._error = std::current_exception();
+		}
+	}
+
+	R get()
+	{
+		if (_error)
+			std::rethrow_exception(_error);
+
+		R & result = *reinterpret_cast<R *>(&_result);
+		R r(std::move(result));
+		result.~R();
+		return r;
+	}
+
+private:
+	F & _f;
+	std::exception_ptr _error;
+	std::aligned_storage_t<sizeof(R), alignof(R)> _result;
+};
+
+template <typename T, typename F>
+struct _fc_op<T, F, void>
+{
+	explicit _fc_op(F & f) noexcept
+		: _f(f), _error()
+	{
+	}
+
+	static void invoke(void * self, T & obj) noexcept
+	{
+		_fc_op & op = *static_cast<_fc_op *>(self);
+		try
+		{
+			op._f(obj);
+		}
+		catch (...)
+		{
+			op._error = std::current_exception();
+		}
+	}
+
+	void get()
+	{
+		if (_error)
+			std::rethrow_exception(_error);
+	}
+
+private:
+	F & _f;
+	std::exception_ptr _error;
+};
+
+template <typename T, std::size_t slots = 64>
+struct flat_combining
+{
+	static_assert(slots != 0 && (slots & (slots - 1)) == 0, "slots must be a power of two");
+
+	using value_type = T;
+
+	template <typename... Args>
+	explicit flat_combining(Args &&... args)
+		: _lock(0), _slots(), _obj(std::forward<Args>(args)...)
+	{
+	}
+
+	flat_combining(flat_combining const &) = delete;
+	flat_combining & operator=(flat_combining const &) = delete;
+
+	// Calls `f(obj)` with exclusive access to the wrapped object,
+	// possibly on another thread, and returns the result.
+	template <typename F>
+	auto apply(F && f) -> decltype(f(std::declval<T &>()))
+	{
+		using op_type = _fc_op<T, std::remove_reference_t<F>, decltype(f(std::declval<T &>()))>;
+
+		// Without contention, skip the publication.
+		std::uint32_t unlocked = _unlocked;
+		if (_lock.compare_exchange_strong(unlocked, _locked, std::memory_order_acquire, std::memory_order_relaxed))
+		{
+			_combiner_guard guard(*this);
+			return f(_obj);
+		}
+
+		op_type op(f);
+		_slot & slot = this->_claim();
+		slot.op = &op;
+		slot.invoke = &op_type::invoke;
+
+		// Seq-cst orders the publication before the check of the lock
+		// in `_mark_or_lock`.
+		slot.state.store(_pending, std::memory_order_seq_cst);
+
+		exponential_backoff backoff;
+		for (;;)
+		{
+			std::uint32_t state = slot.state.load(std::memory_order_acquire);
+			if (state == _done)
+				break;
+
+			if (this->_mark_or_lock())
+			{
+				_combiner_guard guard(*this);
+				this->_combine();
+				continue;
+			}
+
+			if (!backoff.saturated())
+			{
+				backoff();
+				continue;
+			}
+
+			// The lock is marked, so the slot will be processed.
+			if (state == _pending)
+				slot.state.compare_exchange_strong(state, _sleeping, std::memory_order_relaxed);
+			if (state != _done)
+				slot.state.wait(_sleeping, std::memory_order_acquire);
+		}
+
+		slot.state.store(_free, std::memory_order_release);
+		return op.get();
+	}
+
+	// The wrapped object; only safe to use while no `apply` is running.
+	T & unsafe_get() noexcept
+	{
+		return _obj;
+	}
+
+private:
+	// The combiner lock is unlocked, locked, or locked and contended,
+	// meaning that some operations were published while it was taken.
+	static constexpr std::uint32_t _unlocked = 0;
+	static constexpr std::uint32_t _locked = 1;
+	static constexpr std::uint32_t _contended = 2;
+
+	static constexpr std::uint32_t _free = 0;
+	static constexpr std::uint32_t _claimed = 1;
+	static constexpr std::uint32_t _pending = 2;
+	static constexpr std::uint32_t _sleeping = 3;
+	static constexpr std::uint32_t _done = 4;
+
+	struct alignas(hardware_destructive_interference_size) _slot
+	{
+		atomic<std::uint32_t> state;
+		void * op;
+		void (*invoke)(void * op, T & obj);
+	};
+
+	struct _combiner_guard
+	{
+		explicit _combiner_guard(flat_combining & fc) noexcept
+			: _fc(fc)
+		{
+		}
+
+		_combiner_guard(_combiner_guard const &) = delete;
+		_combiner_guard & operator=(_combiner_guard const &) = delete;
+
+		~_combiner_guard()
+		{
+			_fc._unlock();
+		}
+
+	private:
+		flat_combining & _fc;
+	};
+
+	_slot & _claim() noexcept
+	{
+		std::size_t idx = _avakar::atomic_ref::_cpu_hint();
+		for (exponential_backoff backoff;; backoff())
+		{
+			for (std::size_t i = 0; i != slots; ++i)
+			{
+				_slot & slot = _slots[(idx + i) % slots];
+
+				// Acquire pairs with the release of the previous owner.
+				std::uint32_t state = _free;
+				if (slot.state.load(std::memory_order_relaxed) == _free
+					&& slot.state.compare_exchange_strong(state, _claimed, std::memory_order_acquire, std::memory_order_relaxed))
+				{
+					return slot;
+				}
+			}
+		}
+	}
+
+	// Takes the lock if it's free and returns true. Otherwise, marks it
+	// as contended, so that the holder processes the published slots
+	// before it leaves.
+	bool _mark_or_lock() noexcept
+	{
+		for (;;)
+		{
+			std::uint32_t cur = _lock.load(std::memory_order_seq_cst);
+			if (cur == _contended)
+				return false;
+
+			if (cur == _unlocked)
+			{
+				if (_lock.compare_exchange_weak(cur, _locked, std::memory_order_seq_cst, std::memory_order_relaxed))
+					return true;
+			}
+			else if (_lock.compare_exchange_weak(cur, _contended, std::memory_order_seq_cst, std::memory_order_relaxed))
+			{
+				return false;
+			}
+		}
+	}
+
+	void _unlock() noexcept
+	{
+		// Operations published while we held the lock may rely on us,
+		// unless we can pass the duty on to the next holder.
+		while (_lock.exchange(_unlocked, std::memory_order_seq_cst) == _contended)
+		{
+			if (!this->_mark_or_lock())
+				return;
+			this->_combine();
+		}
+	}
+
+	void _combine() noexcept
+	{
+		for (_slot & slot: _slots)
+		{
+			std::uint32_t state = slot.state.load(std::memory_order_acquire);
+			if (state != _pending && state != _sleeping)
+				continue;
+
+			slot.invoke(slot.op, _obj);
+			if (slot.state.exchange(_done, std::memory_order_acq_rel) == _sleeping)
+				slot.state.notify_one();
+		}
+	}
+
+	padded_atomic<std::uint32_t> _lock;
+	_slot _slots[slots];
+	T _obj;
+};
+
+}
+
+#endif // _h
@@ -0,0 +1,337 @@
+#ifndef AVAKAR_HAZARD_POINTER_h
+#define AVAKAR_HAZARD_POINTER_h
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "atomic.h"
+#include "padded_atomic.h"
+
+namespace avakar {
+
+// Hazard pointers, modeled after the C++26 `std::hazard_pointer`.
+//
+// A reader publishes the pointer it is about to dereference in one of
+// the domain's hazard slots; a writer that unlinks an object retires it
+// instead of deleting it, and the domain only reclaims retired objects
+// that no slot points to. Protecting a pointer costs a store and a fence,
+// with no atomic read-modify-write. Retired objects are collected
+// on the domain and scanned in batches, once their number exceeds twice
+// the number of slots, so that each scan reclaims at least half of them.
+//
+//     struct node : avakar::hazard_pointer_obj_base<node> { ... };
+//
+//     avakar::hazard_pointer hp = avakar::make_hazard_pointer();
+//     node * n = hp.protect(head);
+//     ...
+//     old->retire();
+
+struct hazard_domain;
+hazard_domain & default_hazard_domain() noexcept;
+
+struct _hazard_obj
+{
+	_hazard_obj * _next;
+	void const * _key;
+	void (*_reclaim)(_hazard_obj * obj);
+};
+
+struct _hazard_record
+{
+	padded_atomic<void const *> hazard;
+	atomic<bool> active;
+	_hazard_record * next;
+};
+
+struct hazard_domain
+{
+	explicit hazard_domain() noexcept
+		: _records(), _retired(), _retired_count(0), _record_count(0)
+	{
+	}
+
+	hazard_domain(hazard_domain const &) = delete;
+	hazard_domain & operator=(hazard_domain const &) = delete;
+
+	// Reclaims all retired objects. The domain must not be in use.
+	~hazard_domain()
+	{
+		_hazard_obj * obj = _retired.load(std::memory_order_acquire);
+		while (obj != nullptr)
+		{
+			_hazard_obj * next = obj->_next;
+			obj->_reclaim(obj);
+			obj = next;
+		}
+
+		_hazard_record * rec = _records.load(std::memory_order_acquire);
+		while (rec != nullptr)
+		{
+			_hazard_record * next = rec->next;
+			_delete_aligned(rec);
+			rec = next;
+		}
+	}
+
+	_hazard_record * _acquire()
+	{
+		for (_hazard_record * rec = _records.load(std::memory_order_acquire); rec != nullptr; rec = rec->next)
+		{
+			bool active = false;
+			if (!rec->active.load(std::memory_order_relaxed)
+				&& rec->active.compare_exchange_strong(active, true, std::memory_order_acquire, std::memory_order_relaxed))
+			{
+				return rec;
+			}
+		}
+
+		_hazard_record * rec = _new_aligned<_hazard_record>();
+		rec->active.store(true, std::memory_order_relaxed);
+
+		_hazard_record * head = _records.load(std::memory_order_relaxed);
+		do
+			rec->next = head;
+		while (!_records.compare_exchange_weak(head, rec, std::memory_order_release, std::memory_order_relaxed));
+
+		_record_count.fetch_add(1, std::memory_order_relaxed);
+		return rec;
+	}
+
+	void _release(_hazard_record * rec) noexcept
+	{
+		rec->hazard.store(nullptr, std::memory_order_release);
+		rec->active.store(false, std::memory_order_release);
+	}
+
+	void _retire(_hazard_obj * obj)
+	{
+		_hazard_obj * head = _retired.load(std::memory_order_relaxed);
+		do
+			obj->_next = head;
+		while (!_retired.compare_exchange_weak(head, obj, std::memory_order_release, std::memory_order_relaxed));
+
+		std::size_t count = _retired_count.fetch_add(1, std::memory_order_relaxed) + 1;
+		if (count >= _scan_threshold + 2 * _record_count.load(std::memory_order_relaxed))
+			this->cleanup();
+	}
+
+	// Reclaims the retired objects that are not protected. This happens
+	// automatically as objects are retired.
+	void cleanup()
+	{
+		_hazard_obj * obj = _retired.exchange(nullptr, std::memory_order_acquire);
+		if (obj == nullptr)
+			return;
+
+		// Orders the unlinking of the retired objects before the reads
+		// of the hazards; pairs with the fence in `try_protect`.
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+
+		std::vector<void const *> hazards;
+		for (_hazard_record * rec = _records.load(std::memory_order_acquire); rec != nullptr; rec = rec->next)
+		{
+			void const * p = rec->hazard.load(std::memory_order_acquire);
+			if (p != nullptr)
+				hazards.push_back(p);
+		}
+
+		std::sort(hazards.begin(), hazards.end());
+
+		_hazard_obj * kept_head = nullptr;
+		_hazard_obj * kept_tail = nullptr;
+		std::size_t reclaimed = 0;
+
+		while (obj != nullptr)
+		{
+			_hazard_obj * next = obj->_next;
+			if (std::binary_search(hazards.begin(), hazards.end(), obj->_key))
+			{
+				obj->_next = kept_head;
+				kept_head = obj;
+				if (kept_tail == nullptr)
+					kept_tail = obj;
+			}
+			else
+			{
+				obj->_reclaim(obj);
+				++reclaimed;
+			}
+
+			obj = next;
+		}
+
+		_retired_count.fetch_sub(reclaimed, std::memory_order_relaxed);
+
+		if (kept_head != nullptr)
+		{
+			_hazard_obj * head = _retired.load(std::memory_order_relaxed);
+			do
+				kept_tail->_next = head;
+			while (!_retired.compare_exchange_weak(head, kept_head, std::memory_order_release, std::memory_order_relaxed));
+		}
+	}
+
+private:
+	static constexpr std::size_t _scan_threshold = 64;
+
+	atomic<_hazard_record *> _records;
+	atomic<_hazard_obj *> _retired;
+	atomic<std::size_t> _retired_count;
+	atomic<std::size_t> _record_count;
+};
+
+inline hazard_domain & default_hazard_domain() noexcept
+{
+	static hazard_domain domain;
+	return domain;
+}
+
+// Objects that can be retired derive from `hazard_pointer_obj_base`.
+template <typename T, typename D = std::default_delete<T>>
+struct hazard_pointer_obj_base
+	: private _hazard_obj
+{
+	// Hands the object over to `domain`, which calls `d` on it once
+	// it is no longer protected. The object must already be unreachable
+	// for new readers.
+	void retire(D d = D(), hazard_domain & domain = default_hazard_domain())
+	{
+		_deleter = std::move(d);
+		this->_key = static_cast<T const *>(this);
+		this->_reclaim = &hazard_pointer_obj_base::_do_reclaim;
+		domain._retire(this);
+	}
+
+	void retire(hazard_domain & domain)
+	{
+		this->retire(D(), domain);
+	}
+
+protected:
+	hazard_pointer_obj_base() noexcept = default;
+	hazard_pointer_obj_base(hazard_pointer_obj_base const &) noexcept = default;
+	hazard_pointer_obj_base & operator=(hazard_pointer_obj_base const &) noexcept = default;
+	~hazard_pointer_obj_base() = default;
+
+private:
+	static void _do_reclaim(_hazard_obj * obj)
+	{
+		hazard_pointer_obj_base * self = static_cast<hazard_pointer_obj_base *>(obj);
+		D d = std::move(self->_deleter);
+		d(static_cast<T *>(self));
+	}
+
+	D _deleter;
+};
+
+// Owns one hazard slot of a domain.
+struct hazard_pointer
+{
+	hazard_pointer() noexcept
+		: _domain(nullptr), _rec(nullptr)
+	{
+	}
+
+	hazard_pointer(hazard_domain & domain, _hazard_record * rec) noexcept
+		: _domain(&domain), _rec(rec)
+	{
+	}
+
+	hazard_pointer(hazard_pointer && o) noexcept
+		: _domain(o._domain), _rec(o._rec)
+	{
+		o._rec = nullptr;
+	}
+
+	hazard_pointer & operator=(hazard_pointer && o) noexcept
+	{
+		if (this != &o)
+		{
+			if (_rec != nullptr)
+				_domain->_release(_rec);
+			_domain = o._domain;
+			_rec = o._rec;
+			o._rec = nullptr;
+		}
+
+		return *this;
+	}
+
+	~hazard_pointer()
+	{
+		if (_rec != nullptr)
+			_domain->_release(_rec);
+	}
+
+	bool empty() const noexcept
+	{
+		return _rec == nullptr;
+	}
+
+	// Loads a pointer from `src` and protects it; the returned object
+	// can be dereferenced until the protection is reset or replaced.
+	// `src` may be an `atomic_ref<T *>`, `atomic<T *>` or anything else
+	// with a `load(std::memory_order)` member returning a pointer.
+	template <typename Src>
+	auto protect(Src const & src) noexcept
+		-> decltype(src.load(std::memory_order_acquire))
+	{
+		auto ptr = src.load(std::memory_order_relaxed);
+		while (!this->try_protect(ptr, src))
+		{
+		}
+
+		return ptr;
+	}
+
+	// Protects `ptr` if `src` still holds it. Otherwise updates `ptr`
+	// with the current value and returns false.
+	template <typename T, typename Src>
+	bool try_protect(T *& ptr, Src const & src) noexcept
+	{
+		T * p = ptr;
+		this->reset_protection(p);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+
+		ptr = src.load(std::memory_order_acquire);
+		if (ptr == p)
+			return true;
+
+		this->reset_protection();
+		return false;
+	}
+
+	template <typename T>
+	void reset_protection(T const * ptr) noexcept
+	{
+		_rec->hazard.store(ptr, std::memory_order_relaxed);
+	}
+
+	void reset_protection(std::nullptr_t = nullptr) noexcept
+	{
+		_rec->hazard.store(nullptr, std::memory_order_release);
+	}
+
+	void swap(hazard_pointer & o) noexcept
+	{
+		std::swap(_domain, o._domain);
+		std::swap(_rec, o._rec);
+	}
+
+private:
+	hazard_domain * _domain;
+	_hazard_record * _rec;
+};
+
+inline hazard_pointer make_hazard_pointer(hazard_domain & domain = default_hazard_domain())
+{
+	return hazard_pointer(domain, domain._acquire());
+}
+
+}
+
+#endif // _h
@@ -0,0 +1,66 @@
+#ifndef AVAKAR_LATCH_h
+#define AVAKAR_LATCH_h
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include "atomic.h"
+#include "backoff.h"
+
+namespace avakar {
+
+// A single-use countdown, like C++20's `std::latch`. The counter is
+// a 32-bit word, so that waiting threads block on it directly.
+
+struct latch
+{
+	static constexpr std::ptrdiff_t max() noexcept
+	{
+		return INT32_MAX;
+	}
+
+	explicit latch(std::ptrdiff_t expected) noexcept
+		: _counter(static_cast<std::int32_t>(expected))
+	{
+	}
+
+	latch(latch const &) = delete;
+	latch & operator=(latch const &) = delete;
+
+	void count_down(std::ptrdiff_t n = 1) noexcept
+	{
+		std::int32_t prev = _counter.fetch_sub(static_cast<std::int32_t>(n), std::memory_order_release);
+		if (prev == n)
+			_counter.notify_all();
+	}
+
+	bool try_wait() const noexcept
+	{
+		return _counter.load(std::memory_order_acquire) == 0;
+	}
+
+	void wait() const noexcept
+	{
+		for (;;)
+		{
+			std::int32_t cur = _counter.load(std::memory_order_acquire);
+			if (cur == 0)
+				return;
+			spin_wait(_counter, cur, std::memory_order_acquire);
+		}
+	}
+
+	void arrive_and_wait(std::ptrdiff_t n = 1) noexcept
+	{
+		this->count_down(n);
+		this->wait();
+	}
+
+private:
+	atomic<std::int32_t> _counter;
+};
+
+}
+
+#endif // _h
@@ -0,0 +1,117 @@
+#ifndef AVAKAR_MCS_LOCK_h
+#define AVAKAR_MCS_LOCK_h
+
+#include <atomic>
+
+#include "atomic.h"
+#include "backoff.h"
+#include "padded_atomic.h"
+
+namespace avakar {
+
+// The Mellor-Crummey and Scott queue lock.
+//
+// Each waiter brings a node, typically on its stack, and appends it
+// to the queue by exchanging the lock's tail pointer. It then spins on
+// a flag in its own node, which its predecessor clears on unlock. Each
+// hand-over thus touches only the cache lines of the two threads involved,
+// no matter how many threads wait, and the lock is fair.
+//
+//     avakar::mcs_lock::node node;
+//     lock.lock(node);
+//     ...
+//     lock.unlock(node);
+//
+// or, equivalently, `avakar::mcs_lock::guard g(lock);`.
+
+struct mcs_lock
+{
+	struct alignas(hardware_destructive_interference_size) node
+	{
+		explicit node() noexcept
+			: next(nullptr), locked(false)
+		{
+		}
+
+		node(node const &) = delete;
+		node & operator=(node const &) = delete;
+
+		atomic<node *> next;
+		atomic<bool> locked;
+	};
+
+	struct guard
+	{
+		explicit guard(mcs_lock & lock) noexcept
+			: _lock(lock)
+		{
+			_lock.lock(_node);
+		}
+
+		guard(guard const &) = delete;
+		guard & operator=(guard const &) = delete;
+
+		~guard()
+		{
+			_lock.unlock(_node);
+		}
+
+	private:
+		mcs_lock & _lock;
+		node _node;
+	};
+
+	explicit mcs_lock() noexcept
+		: _tail(nullptr)
+	{
+	}
+
+	mcs_lock(mcs_lock const &) = delete;
+	mcs_lock & operator=(mcs_lock const &) = delete;
+
+	bool try_lock(node & n) noexcept
+	{
+		n.next.store(nullptr, std::memory_order_relaxed);
+
+		node * expected = nullptr;
+		return _tail.compare_exchange_strong(expected, &n, std::memory_order_acquire, std::memory_order_relaxed);
+	}
+
+	void lock(node & n) noexcept
+	{
+		n.next.store(nullptr, std::memory_order_relaxed);
+		n.locked.store(true, std::memory_order_relaxed);
+
+		node * pred = _tail.exchange(&n, std::memory_order_acq_rel);
+		if (pred == nullptr)
+			return;
+
+		pred->next.store(&n, std::memory_order_release);
+		while (n.locked.load(std::memory_order_acquire))
+			cpu_relax();
+	}
+
+	void unlock(node & n) noexcept
+	{
+		node * succ = n.next.load(std::memory_order_acquire);
+		if (succ == nullptr)
+		{
+			node * expected = &n;
+			if (_tail.compare_exchange_strong(expected, nullptr, std::memory_order_release, std::memory_order_relaxed))
+				return;
+
+			// A successor has swapped the tail but not yet linked itself.
+			while ((succ = n.next.load(std::memory_order_acquire)) == nullptr)
+				cpu_relax();
+		}
+
+		succ->locked.store(false, std::memory_order_release);
+	}
+
+private:
+	atomic<node *> _tail;
+};
+
+}
+
+#endif // _h
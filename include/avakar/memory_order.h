@@ -0,0 +1,38 @@
+#ifndef AVAKAR_MEMORY_ORDER_h
+#define AVAKAR_MEMORY_ORDER_h
+
+#include <atomic>
+#include <type_traits>
+
+namespace avakar {
+
+// Memory orders as types. Passing one of these instead of a `std::memory_order`
+// selects the instruction sequence at compile time, regardless of inlining
+// or optimization level.
+
+template <std::memory_order order>
+using memory_order_t = std::integral_constant<std::memory_order, order>;
+
+using memory_order_relaxed_t = memory_order_t<std::memory_order_relaxed>;
+using memory_order_consume_t = memory_order_t<std::memory_order_consume>;
+using memory_order_acquire_t = memory_order_t<std::memory_order_acquire>;
+using memory_order_release_t = memory_order_t<std::memory_order_release>;
+using memory_order_acq_rel_t = memory_order_t<std::memory_order_acq_rel>;
+using memory_order_seq_cst_t = memory_order_t<std::memory_order_seq_cst>;
+
+template <std::memory_order order>
+using _failure_order_t = memory_order_t<
+	order == std::memory_order_release? std::memory_order_relaxed
+	: order == std::memory_order_acq_rel? std::memory_order_acquire
+	: order>;
+
+constexpr std::memory_order _failure_order(std::memory_order order) noexcept
+{
+	return order == std::memory_order_release? std::memory_order_relaxed
+		: order == std::memory_order_acq_rel? std::memory_order_acquire
+		: order;
+}
+
+}
+
+#endif // _h
@@ -0,0 +1,284 @@
+#ifndef AVAKAR_MPMC_QUEUE_h
+#define AVAKAR_MPMC_QUEUE_h
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include "atomic.h"
+#include "padded_atomic.h"
+
+namespace avakar {
+
+// A bounded multi-producer, multi-consumer queue after Dmitry Vyukov.
+//
+// Each slot carries a sequence number that says whose turn it is:
+// the slot at position `pos` is free for the producer that claims `pos`
+// when the sequence equals `pos`, and full for the consumer that claims
+// `pos` when it equals `pos + 1`. Producers and consumers claim positions
+// on two separate counters, so they don't contend with each other,
+// and hand a slot over with a release store of its sequence.
+//
+// The `try_` operations claim a position with a CAS only once its slot
+// is ready and fail if the queue is full (or empty). Unless `blocking`
+// is false, there are also blocking operations, which claim a position
+// unconditionally with `fetch_add` and wait on the slot's sequence until
+// it's their turn. To avoid lost wake-ups, every hand-over in a blocking
+// queue, including those of the `try_` operations, is then followed by
+// a seq-cst fence and a check for blocked threads, and calls `notify_all`
+// only if there are some. A queue with `blocking` set to false only
+// has the `try_` operations and hands slots over with the release
+// store alone.
+
+template <typename T, bool blocking = true>
+struct mpmc_queue
+{
+	static_assert(std::is_nothrow_move_constructible<T>::value, "T must be nothrow move constructible");
+
+	using value_type = T;
+	using size_type = std::size_t;
+
+	// The capacity is rounded up to a power of two, at least two.
+	explicit mpmc_queue(size_type capacity)
+		: _mask(_round_up(capacity) - 1), _slots(new _slot[_mask + 1])
+	{
+		for (std::size_t i = 0; i <= _mask; ++i)
+			_slots[i].seq.store(i, std::memory_order_relaxed);
+	}
+
+	mpmc_queue(mpmc_queue const &) = delete;
+	mpmc_queue & operator=(mpmc_queue const &) = delete;
+
+	~mpmc_queue()
+	{
+		std::size_t tail = _tail.load(std::memory_order_relaxed);
+		for (std::size_t head = _head.load(std::memory_order_relaxed); head != tail; ++head)
+			_slots[head & _mask].value()->~T();
+	}
+
+	size_type capacity() const noexcept
+	{
+		return _mask + 1;
+	}
+
+	// A position, once claimed, must be handed over, so elements whose
+	// constructor may throw are constructed before claiming one
+	// and then moved into the slot.
+	template <typename... Args>
+	auto try_emplace(Args &&... args)
+		-> std::enable_if_t<!std::is_nothrow_constructible<T, Args &&...>::value, bool>
+	{
+		T value(std::forward<Args>(args)...);
+		return this->try_emplace(std::move(value));
+	}
+
+	template <typename... Args>
+	auto try_emplace(Args &&... args)
+		-> std::enable_if_t<std::is_nothrow_constructible<T, Args &&...>::value, bool>
+	{
+		std::size_t pos = _tail.load(std::memory_order_relaxed);
+		for (;;)
+		{
+			_slot & slot = _slots[pos & _mask];
+			std::size_t seq = slot.seq.load(std::memory_order_acquire);
+
+			std::ptrdiff_t diff = static_cast<std::ptrdiff_t>(seq - pos);
+			if (diff == 0)
+			{
+				if (_tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+				{
+					this->_fill(slot, pos, std::forward<Args>(args)...);
+					return true;
+				}
+			}
+			else if (diff < 0)
+			{
+				// The slot still holds the element from the previous lap.
+				return false;
+			}
+			else
+			{
+				pos = _tail.load(std::memory_order_relaxed);
+			}
+		}
+	}
+
+	bool try_push(T const & value)
+	{
+		return this->try_emplace(value);
+	}
+
+	bool try_push(T && value)
+	{
+		return this->try_emplace(std::move(value));
+	}
+
+	bool try_pop(T & value)
+	{
+		std::size_t pos = _head.load(std::memory_order_relaxed);
+		for (;;)
+		{
+			_slot & slot = _slots[pos & _mask];
+			std::size_t seq = slot.seq.load(std::memory_order_acquire);
+
+			std::ptrdiff_t diff = static_cast<std::ptrdiff_t>(seq - (pos + 1));
+			if (diff == 0)
+			{
+				if (_head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+				{
+					this->_drain(slot, pos, value);
+					return true;
+				}
+			}
+			else if (diff < 0)
+			{
+				return false;
+			}
+			else
+			{
+				pos = _head.load(std::memory_order_relaxed);
+			}
+		}
+	}
+
+	// Blocks while the queue is full.
+	template <typename... Args>
+	auto emplace(Args &&... args)
+		-> std::enable_if_t<!std::is_nothrow_constructible<T, Args &&...>::value>
+	{
+		T value(std::forward<Args>(args)...);
+		this->emplace(std::move(value));
+	}
+
+	template <typename... Args>
+	auto emplace(Args &&... args)
+		-> std::enable_if_t<std::is_nothrow_constructible<T, Args &&...>::value>
+	{
+		static_assert(blocking, "the queue doesn't support blocking operations");
+		std::size_t pos = _tail.fetch_add(1, std::memory_order_relaxed);
+		_slot & slot = _slots[pos & _mask];
+		_await(slot, pos);
+		this->_fill(slot, pos, std::forward<Args>(args)...);
+	}
+
+	void push(T const & value)
+	{
+		this->emplace(value);
+	}
+
+	void push(T && value)
+	{
+		this->emplace(std::move(value));
+	}
+
+	// Blocks while the queue is empty.
+	void pop(T & value)
+	{
+		static_assert(blocking, "the queue doesn't support blocking operations");
+		std::size_t pos = _head.fetch_add(1, std::memory_order_relaxed);
+		_slot & slot = _slots[pos & _mask];
+		_await(slot, pos + 1);
+		this->_drain(slot, pos, value);
+	}
+
+private:
+	struct _slot
+	{
+		atomic<std::size_t> seq;
+		std::aligned_storage_t<sizeof(T), alignof(T)> storage;
+
+		T * value() noexcept
+		{
+			return reinterpret_cast<T *>(&storage);
+		}
+	};
+
+	static size_type _round_up(size_type n) noexcept
+	{
+		size_type r = 2;
+		while (r < n)
+			r *= 2;
+		return r;
+	}
+
+	void _await(_slot & slot, std::size_t seq) noexcept
+	{
+		std::size_t cur = slot.seq.load(std::memory_order_acquire);
+		if (cur == seq)
+			return;
+
+		// Announce the waiter before the final check of the sequence;
+		// pairs with `_publish`.
+		_waiters.fetch_add(1, std::memory_order_seq_cst);
+		for (;;)
+		{
+			cur = slot.seq.load(std::memory_order_seq_cst);
+			if (cur == seq)
+				break;
+			slot.seq.wait(cur, std::memory_order_relaxed);
+		}
+
+		_waiters.fetch_sub(1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_acquire);
+	}
+
+	// Hands the slot over, waking blocked threads if there are any.
+	void _publish(_slot & slot, std::size_t seq) noexcept
+	{
+		slot.seq.store(seq, std::memory_order_release);
+		this->_notify(slot, std::integral_constant<bool, blocking>());
+	}
+
+	void _notify(_slot &, std::false_type) noexcept
+	{
+	}
+
+	void _notify(_slot & slot, std::true_type) noexcept
+	{
+		// Orders the hand-over before the check for waiters; pairs with
+		// the announcement in `_await`.
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (_waiters.load(std::memory_order_relaxed) != 0)
+			slot.seq.notify_all();
+	}
+
+	template <typename... Args>
+	void _fill(_slot & slot, std::size_t pos, Args &&... args)
+	{
+		::new(static_cast<void *>(&slot.storage)) T(std::forward<Args>(args)...);
+		this->_publish(slot, pos + 1);
+	}
+
+	// If the assignment throws, the element is dropped, but the slot
+	// is still handed back to the producers.
+	void _drain(_slot & slot, std::size_t pos, T & value)
+	{
+		T * obj = slot.value();
+		try
+		{
+			value = std::move(*obj);
+		}
+		catch (...)
+		{
+			obj->~T();
+			this->_publish(slot, pos + _mask + 1);
+			throw;
+		}
+
+		obj->~T();
+		this->_publish(slot, pos + _mask + 1);
+	}
+
+	std::size_t const _mask;
+	std::unique_ptr<_slot[]> const _slots;
+	padded_atomic<std::size_t> _tail;
+	padded_atomic<std::size_t> _head;
+	padded_atomic<std::size_t> _waiters;
+};
+
+}
+
+#endif // _h
@@ -0,0 +1,86 @@
+#ifndef AVAKAR_MUTEX_h
+#define AVAKAR_MUTEX_h
+
+#include <atomic>
+#include <cstdint>
+
+#include "atomic.h"
+#include "backoff.h"
+
+namespace avakar {
+
+// A mutex in a single 32-bit word, after Ulrich Drepper's
+// "Futexes Are Tricky".
+//
+// The word is 0 when unlocked, 1 when locked and 2 when locked
+// and some threads may be blocked. Uncontended `lock` and `unlock` are
+// one atomic operation each. A contending thread first spins for a while
+// with exponential backoff, as short critical sections tend to end
+// before it would be worth to block, and then blocks in `wait`, which
+// is `FUTEX_WAIT_PRIVATE` on Linux and `WaitOnAddress` on Windows.
+// `unlock` only issues a wake-up if the word says there may be
+// blocked threads.
+//
+// The mutex satisfies the Lockable requirements, so it works with
+// `std::lock_guard` and `std::unique_lock`.
+
+struct mutex
+{
+	explicit mutex() noexcept
+		: _state(0)
+	{
+	}
+
+	mutex(mutex const &) = delete;
+	mutex & operator=(mutex const &) = delete;
+
+	bool try_lock() noexcept
+	{
+		std::uint32_t expected = 0;
+		return _state.compare_exchange_strong(expected, 1, std::memory_order_acquire, std::memory_order_relaxed);
+	}
+
+	void lock() noexcept
+	{
+		if (!this->try_lock())
+			this->_lock_slow();
+	}
+
+	void unlock() noexcept
+	{
+		if (_state.exchange(0, std::memory_order_release) == 2)
+			_state.notify_one();
+	}
+
+private:
+	static constexpr int _spin_rounds = 10;
+
+	void _lock_slow() noexcept
+	{
+		// Spin while the owner is the only other thread around.
+		exponential_backoff backoff;
+		for (int i = 0; i != _spin_rounds; ++i)
+		{
+			backoff();
+
+			std::uint32_t cur = _state.load(std::memory_order_relaxed);
+			if (cur == 2)
+				break;
+
+			if (cur == 0 && this->try_lock())
+				return;
+		}
+
+		// Mark the mutex as contended, so that the owner wakes us up.
+		// Having done so, we must leave it marked even if we get it,
+		// as there may be other blocked threads.
+		while (_state.exchange(2, std::memory_order_acquire) != 0)
+			_state.wait(2, std::memory_order_relaxed);
+	}
+
+	atomic<std::uint32_t> _state;
+};
+
+}
+
+#endif // _h
@@ -0,0 +1,230 @@
+#ifndef AVAKAR_OBJECT_POOL_h
+#define AVAKAR_OBJECT_POOL_h
+
+#include <atomic>
+#include <cstddef>
+#include <initializer_list>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include "atomic.h"
+#include "padded_atomic.h"
+#include "treiber_stack.h"
+
+namespace avakar {
+
+// A pool of fixed-size objects with per-thread magazines, after
+// Bonwick and Adams' "Magazines and Vmem".
+//
+// A magazine is an array of up to `magazine_size` pointers to free
+// objects. Each thread allocates from and frees to its own `cache`,
+// which holds two magazines; only when both are empty (or full) does it
+// trade a whole magazine with the pool's depot, a pair of `treiber_stack`s
+// holding non-empty and empty magazines, with a single CAS. Thus most
+// allocate/deallocate pairs touch no shared cache line at all.
+// The non-empty magazines are usually full, but a destroyed cache
+// returns its magazines as they are.
+// When the depot runs out of non-empty magazines, the pool allocates
+// a slab of `magazine_size` objects at once. Slabs and magazines are only
+// freed with the pool, which also keeps the depot safe from ABA.
+//
+//     avakar::object_pool<message> pool;
+//
+//     // in each thread
+//     avakar::object_pool<message>::cache cache(pool);
+//     message * m = cache.create(args...);
+//     ...
+//     cache.destroy(m);
+//
+// Objects may be freed to a cache other than the one they came from.
+// The caches must be destroyed before the pool.
+
+template <typename T, std::size_t magazine_size = 32>
+struct object_pool
+{
+	static_assert(magazine_size != 0, "magazines must not be empty");
+
+private:
+	struct _magazine
+		: treiber_stack_hook
+	{
+		explicit _magazine() noexcept
+			: count(0)
+		{
+		}
+
+		std::size_t count;
+		T * objs[magazine_size];
+	};
+
+	using _block = std::aligned_storage_t<sizeof(T), alignof(T)>;
+
+	struct _slab
+	{
+		_slab * next;
+		_block blocks[magazine_size];
+	};
+
+public:
+	using value_type = T;
+
+	struct cache
+	{
+		explicit cache(object_pool & pool)
+			: _pool(pool), _loaded(pool._get_empty()), _previous(nullptr)
+		{
+			try
+			{
+				_previous = pool._get_empty();
+			}
+			catch (...)
+			{
+				_pool._put(_loaded);
+				throw;
+			}
+		}
+
+		cache(cache const &) = delete;
+		cache & operator=(cache const &) = delete;
+
+		~cache()
+		{
+			_pool._put(_loaded);
+			_pool._put(_previous);
+		}
+
+		// Returns uninitialized storage for a `T`.
+		T * allocate()
+		{
+			if (_loaded->count == 0)
+			{
+				// `_previous` may be partly filled, e.g. after a `deallocate`
+				// swapped the magazines; only an empty one needs a reload.
+				if (_previous->count == 0)
+					_pool._reload(_previous);
+				std::swap(_loaded, _previous);
+			}
+
+			return _loaded->objs[--_loaded->count];
+		}
+
+		void deallocate(T * ptr)
+		{
+			if (_loaded->count == magazine_size)
+			{
+				if (_previous->count != 0)
+				{
+					_pool._put(_previous);
+					_previous = _pool._get_empty();
+				}
+
+				std::swap(_loaded, _previous);
+			}
+
+			_loaded->objs[_loaded->count++] = ptr;
+		}
+
+		template <typename... Args>
+		T * create(Args &&... args)
+		{
+			T * ptr = this->allocate();
+			try
+			{
+				return ::new(static_cast<void *>(ptr)) T(std::forward<Args>(args)...);
+			}
+			catch (...)
+			{
+				this->deallocate(ptr);
+				throw;
+			}
+		}
+
+		void destroy(T * ptr)
+		{
+			ptr->~T();
+			this->deallocate(ptr);
+		}
+
+	private:
+		object_pool & _pool;
+		_magazine * _loaded;
+		_magazine * _previous;
+	};
+
+	explicit object_pool() noexcept
+		: _full(), _empty(), _slabs(nullptr)
+	{
+	}
+
+	object_pool(object_pool const &) = delete;
+	object_pool & operator=(object_pool const &) = delete;
+
+	// Frees the slabs and magazines. All objects must have been destroyed.
+	~object_pool()
+	{
+		for (treiber_stack<_magazine> * depot: { &_full, &_empty })
+		{
+			_magazine * mag = depot->pop_all();
+			while (mag != nullptr)
+			{
+				_magazine * next = treiber_stack<_magazine>::next(mag);
+				delete mag;
+				mag = next;
+			}
+		}
+
+		_slab * slab = _slabs.load(std::memory_order_acquire);
+		while (slab != nullptr)
+		{
+			_slab * next = slab->next;
+			_delete_aligned(slab);
+			slab = next;
+		}
+	}
+
+private:
+	_magazine * _get_empty()
+	{
+		_magazine * mag = _empty.pop();
+		return mag != nullptr? mag: new _magazine();
+	}
+
+	void _put(_magazine * mag) noexcept
+	{
+		if (mag->count != 0)
+			_full.push(mag);
+		else
+			_empty.push(mag);
+	}
+
+	// Replaces the empty magazine `mag` with a non-empty one.
+	void _reload(_magazine *& mag)
+	{
+		if (_magazine * full = _full.pop())
+		{
+			_empty.push(mag);
+			mag = full;
+			return;
+		}
+
+		_slab * slab = _new_aligned<_slab>();
+
+		_slab * head = _slabs.load(std::memory_order_relaxed);
+		do
+			slab->next = head;
+		while (!_slabs.compare_exchange_weak(head, slab, std::memory_order_release, std::memory_order_relaxed));
+
+		for (_block & block: slab->blocks)
+			mag->objs[mag->count++] = reinterpret_cast<T *>(&block);
+	}
+
+	// Non-empty magazines.
+	treiber_stack<_magazine> _full;
+	treiber_stack<_magazine> _empty;
+	atomic<_slab *> _slabs;
+};
+
+}
+
+#endif // _h
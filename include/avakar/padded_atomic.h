@@ -0,0 +1,148 @@
+#ifndef AVAKAR_PADDED_ATOMIC_h
+#define AVAKAR_PADDED_ATOMIC_h
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <utility>
+
+#include "atomic.h"
+
+namespace avakar {
+
+// The size of a block of memory that two threads must not both write to
+// if they are to proceed independently, known at compile time unlike
+// C++17's constant of the same name, which not all standard libraries
+// define. This is the cache line size of the target, except on x86,
+// where the spatial prefetcher pulls in lines in 128-byte aligned pairs,
+// so that writes to the neighbouring line still cause false sharing.
+#if defined(__i386__) || defined(__x86_64__) || defined(_M_IX86) || defined(_M_AMD64)
+constexpr std::size_t hardware_destructive_interference_size = 2 * _avakar::atomic_ref::cache_line_size;
+#else
+constexpr std::size_t hardware_destructive_interference_size = _avakar::atomic_ref::cache_line_size;
+#endif
+
+// An `atomic<T>` alone on its own cache line(s).
+//
+// Note that the type is over-aligned; before C++17, allocating it
+// on the heap may not respect the alignment.
+
+template <typename T>
+struct alignas(hardware_destructive_interference_size) padded_atomic
+	: atomic<T>
+{
+	explicit padded_atomic() noexcept
+		: atomic<T>()
+	{
+	}
+
+	explicit padded_atomic(T desired) noexcept
+		: atomic<T>(desired)
+	{
+	}
+
+	using atomic<T>::operator=;
+};
+
+// Allocates and frees over-aligned objects, which plain `new` doesn't
+// support before C++17. The pointer returned by `operator new` is kept
+// just before the object.
+
+template <typename T, typename... Args>
+T * _new_aligned(Args &&... args)
+{
+	static_assert(alignof(T) >= sizeof(void *), "use plain new");
+
+	void * raw = ::operator new(sizeof(T) + alignof(T));
+	std::uintptr_t addr = (reinterpret_cast<std::uintptr_t>(raw) + alignof(T)) & ~std::uintptr_t(alignof(T) - 1);
+	reinterpret_cast<void **>(addr)[-1] = raw;
+
+	try
+	{
+		return ::new(reinterpret_cast<void *>(addr)) T(std::forward<Args>(args)...);
+	}
+	catch (...)
+	{
+		::operator delete(raw);
+		throw;
+	}
+}
+
+template <typename T>
+void _delete_aligned(T * ptr) noexcept
+{
+	void * raw = reinterpret_cast<void **>(ptr)[-1];
+	ptr->~T();
+	::operator delete(raw);
+}
+
+// A fixed-size array of atomics, each on its own cache line(s),
+// e.g. for per-thread slots.
+
+template <typename T, std::size_t N>
+struct padded_atomic_array
+{
+	static_assert(N != 0, "the array must not be empty");
+
+	using value_type = padded_atomic<T>;
+	using size_type = std::size_t;
+	using iterator = padded_atomic<T> *;
+	using const_iterator = padded_atomic<T> const *;
+
+	explicit padded_atomic_array() noexcept
+		: _elems()
+	{
+	}
+
+	explicit padded_atomic_array(T desired) noexcept
+		: _elems()
+	{
+		for (padded_atomic<T> & elem: _elems)
+			elem.store(desired, std::memory_order_relaxed);
+	}
+
+	padded_atomic_array(padded_atomic_array const &) = delete;
+	padded_atomic_array & operator=(padded_atomic_array const &) = delete;
+
+	static constexpr size_type size() noexcept
+	{
+		return N;
+	}
+
+	padded_atomic<T> & operator[](size_type idx) noexcept
+	{
+		return _elems[idx];
+	}
+
+	padded_atomic<T> const & operator[](size_type idx) const noexcept
+	{
+		return _elems[idx];
+	}
+
+	iterator begin() noexcept
+	{
+		return _elems;
+	}
+
+	const_iterator begin() const noexcept
+	{
+		return _elems;
+	}
+
+	iterator end() noexcept
+	{
+		return _elems + N;
+	}
+
+	const_iterator end() const noexcept
+	{
+		return _elems + N;
+	}
+
+private:
+	padded_atomic<T> _elems[N];
+};
+
+}
+
+#endif // _h
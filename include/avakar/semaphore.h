@@ -0,0 +1,76 @@
+#ifndef AVAKAR_SEMAPHORE_h
+#define AVAKAR_SEMAPHORE_h
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include "atomic.h"
+#include "backoff.h"
+
+namespace avakar {
+
+// A counting semaphore, like C++20's `std::counting_semaphore`.
+// The count is a 32-bit word; threads that find it at zero spin
+// for a while and then block on it.
+
+template <std::ptrdiff_t least_max_value = INT32_MAX>
+struct counting_semaphore
+{
+	static_assert(least_max_value >= 0 && least_max_value <= INT32_MAX, "least_max_value is out of range");
+
+	static constexpr std::ptrdiff_t max() noexcept
+	{
+		return least_max_value;
+	}
+
+	explicit counting_semaphore(std::ptrdiff_t desired) noexcept
+		: _count(static_cast<std::int32_t>(desired))
+	{
+	}
+
+	counting_semaphore(counting_semaphore const &) = delete;
+	counting_semaphore & operator=(counting_semaphore const &) = delete;
+
+	void release(std::ptrdiff_t update = 1) noexcept
+	{
+		_count.fetch_add(static_cast<std::int32_t>(update), std::memory_order_release);
+
+		// Only blocked threads make this more than a fence and a load.
+		if (update == 1)
+			_count.notify_one();
+		else
+			_count.notify_all();
+	}
+
+	bool try_acquire() noexcept
+	{
+		std::int32_t cur = _count.load(std::memory_order_relaxed);
+		while (cur > 0)
+		{
+			if (_count.compare_exchange_weak(cur, cur - 1, std::memory_order_acquire, std::memory_order_relaxed))
+				return true;
+		}
+
+		return false;
+	}
+
+	void acquire() noexcept
+	{
+		for (;;)
+		{
+			if (this->try_acquire())
+				return;
+			spin_wait(_count, 0, std::memory_order_relaxed);
+		}
+	}
+
+private:
+	atomic<std::int32_t> _count;
+};
+
+using binary_semaphore = counting_semaphore<1>;
+
+}
+
+#endif // _h
@@ -0,0 +1,150 @@
+#ifndef AVAKAR_SHARED_MUTEX_h
+#define AVAKAR_SHARED_MUTEX_h
+
+#include <atomic>
+#include <cstdint>
+
+#include "atomic.h"
+#include "backoff.h"
+
+namespace avakar {
+
+// A reader-writer lock in a single 32-bit word that prefers writers.
+//
+// The low bits count the readers. A writer that finds readers inside
+// sets the writer-pending bit, which keeps new readers out until it gets
+// in and sets the writer bit. Uncontended, `lock_shared` is
+// one `fetch_add` and `lock` one CAS, as are the unlocks. Contending
+// threads spin for a while and then block in `wait`; they announce it
+// in the waiters bit, so unlocking threads only issue a wake-up
+// when somebody is blocked.
+//
+// The mutex satisfies the SharedLockable requirements, so it works
+// with `std::shared_lock` as well as `std::lock_guard`.
+
+struct shared_mutex
+{
+	explicit shared_mutex() noexcept
+		: _state(0)
+	{
+	}
+
+	shared_mutex(shared_mutex const &) = delete;
+	shared_mutex & operator=(shared_mutex const &) = delete;
+
+	bool try_lock() noexcept
+	{
+		std::uint32_t cur = _state.load(std::memory_order_relaxed);
+		return (cur & (_readers | _writer)) == 0
+			&& _state.compare_exchange_strong(cur, (cur & ~_pending) | _writer, std::memory_order_acquire, std::memory_order_relaxed);
+	}
+
+	void lock() noexcept
+	{
+		std::uint32_t cur = 0;
+		if (_state.compare_exchange_strong(cur, _writer, std::memory_order_acquire, std::memory_order_relaxed))
+			return;
+
+		exponential_backoff backoff;
+		for (;;)
+		{
+			if ((cur & (_readers | _writer)) == 0)
+			{
+				if (_state.compare_exchange_weak(cur, (cur & ~_pending) | _writer, std::memory_order_acquire, std::memory_order_relaxed))
+					return;
+				continue;
+			}
+
+			if ((cur & _pending) == 0)
+			{
+				_state.compare_exchange_weak(cur, cur | _pending, std::memory_order_relaxed);
+				continue;
+			}
+
+			cur = this->_pause(cur, backoff);
+		}
+	}
+
+	void unlock() noexcept
+	{
+		std::uint32_t prev = _state.fetch_and(~(_writer | _waiters), std::memory_order_release);
+		if (prev & _waiters)
+			_state.notify_all();
+	}
+
+	bool try_lock_shared() noexcept
+	{
+		std::uint32_t cur = _state.load(std::memory_order_relaxed);
+		return (cur & (_writer | _pending)) == 0
+			&& _state.compare_exchange_strong(cur, cur + 1, std::memory_order_acquire, std::memory_order_relaxed);
+	}
+
+	void lock_shared() noexcept
+	{
+		std::uint32_t cur = _state.fetch_add(1, std::memory_order_acquire);
+		if ((cur & (_writer | _pending)) == 0)
+			return;
+
+		// Back out and let the writer go first.
+		this->unlock_shared();
+
+		exponential_backoff backoff;
+		cur = _state.load(std::memory_order_relaxed);
+		for (;;)
+		{
+			if ((cur & (_writer | _pending)) == 0)
+			{
+				if (_state.compare_exchange_weak(cur, cur + 1, std::memory_order_acquire, std::memory_order_relaxed))
+					return;
+				continue;
+			}
+
+			cur = this->_pause(cur, backoff);
+		}
+	}
+
+	void unlock_shared() noexcept
+	{
+		std::uint32_t prev = _state.fetch_sub(1, std::memory_order_release);
+
+		// The last reader out wakes the writers waiting for it.
+		if ((prev & _readers) == 1 && (prev & _waiters))
+		{
+			_state.fetch_and(~_waiters, std::memory_order_relaxed);
+			_state.notify_all();
+		}
+	}
+
+private:
+	static constexpr std::uint32_t _writer = 0x80000000;
+	static constexpr std::uint32_t _pending = 0x40000000;
+	static constexpr std::uint32_t _waiters = 0x20000000;
+	static constexpr std::uint32_t _readers = 0x1fffffff;
+
+	// Spins while the backoff isn't saturated, then blocks until
+	// the state changes from `cur`. Returns the new state.
+	std::uint32_t _pause(std::uint32_t cur, exponential_backoff & backoff) noexcept
+	{
+		if (!backoff.saturated())
+		{
+			backoff();
+			return _state.load(std::memory_order_relaxed);
+		}
+
+		if ((cur & _waiters) == 0)
+		{
+			if (!_state.compare_exchange_weak(cur, cur | _waiters, std::memory_order_relaxed))
+				return cur;
+			cur |= _waiters;
+		}
+
+		_state.wait(cur, std::memory_order_relaxed);
+		return _state.load(std::memory_order_relaxed);
+	}
+
+	atomic<std::uint32_t> _state;
+};
+
+}
+
+#endif // _h
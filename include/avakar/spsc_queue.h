@@ -0,0 +1,219 @@
+#ifndef AVAKAR_SPSC_QUEUE_h
+#define AVAKAR_SPSC_QUEUE_h
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <utility>
+
+#include "atomic.h"
+#include "padded_atomic.h"
+
+namespace avakar {
+
+// A bounded single-producer, single-consumer ring buffer.
+//
+// The producer owns the tail index and the consumer the head index;
+// each lives on its own cache line together with the owner's cached copy
+// of the other index. The owner re-reads the other index only when
+// the cached copy says the queue is full (or empty), so in the steady
+// state the two threads only share the cache lines of the elements.
+// The batch operations publish their index once per batch.
+//
+// At most one thread may push and at most one thread may pop at a time.
+
+template <typename T>
+struct spsc_queue
+{
+	using value_type = T;
+	using size_type = std::size_t;
+
+	// The capacity is rounded up to a power of two.
+	explicit spsc_queue(size_type capacity)
+		: _mask(_round_up(capacity) - 1), _buf(std::allocator<T>().allocate(_mask + 1))
+	{
+	}
+
+	spsc_queue(spsc_queue const &) = delete;
+	spsc_queue & operator=(spsc_queue const &) = delete;
+
+	~spsc_queue()
+	{
+		std::size_t tail = _producer.tail.load(std::memory_order_relaxed);
+		for (std::size_t head = _consumer.head.load(std::memory_order_relaxed); head != tail; ++head)
+			_buf[head & _mask].~T();
+		std::allocator<T>().deallocate(_buf, _mask + 1);
+	}
+
+	size_type capacity() const noexcept
+	{
+		return _mask + 1;
+	}
+
+	// The number of elements; exact only when called by the producer
+	// or the consumer while the other one is idle.
+	size_type size() const noexcept
+	{
+		std::size_t head = _consumer.head.load(std::memory_order_acquire);
+		return _producer.tail.load(std::memory_order_acquire) - head;
+	}
+
+	bool empty() const noexcept
+	{
+		return this->size() == 0;
+	}
+
+	// Producer side.
+
+	template <typename... Args>
+	bool try_emplace(Args &&... args)
+	{
+		std::size_t tail = _producer.tail.load(std::memory_order_relaxed);
+		if (this->_free(tail, 1) == 0)
+			return false;
+
+		::new(static_cast<void *>(&_buf[tail & _mask])) T(std::forward<Args>(args)...);
+		_producer.tail.store(tail + 1, std::memory_order_release);
+		return true;
+	}
+
+	bool try_push(T const & value)
+	{
+		return this->try_emplace(value);
+	}
+
+	bool try_push(T && value)
+	{
+		return this->try_emplace(std::move(value));
+	}
+
+	// Copies up to `n` elements from `first` into the queue and returns
+	// their number. If a copy throws, the queue is left unchanged.
+	template <typename ForwardIt>
+	size_type push_n(ForwardIt first, size_type n)
+	{
+		std::size_t tail = _producer.tail.load(std::memory_order_relaxed);
+		n = this->_free(tail, n);
+
+		// Copy in at most two contiguous runs, so that trivially copyable
+		// elements turn into memcpy.
+		std::size_t idx = tail & _mask;
+		std::size_t first_run = (std::min)(n, _mask + 1 - idx);
+		std::uninitialized_copy_n(first, first_run, _buf + idx);
+		try
+		{
+			std::uninitialized_copy_n(std::next(first, first_run), n - first_run, _buf);
+		}
+		catch (...)
+		{
+			// The second run cleans up after itself, the first one doesn't.
+			for (std::size_t i = 0; i != first_run; ++i)
+				_buf[idx + i].~T();
+			throw;
+		}
+
+		_producer.tail.store(tail + n, std::memory_order_release);
+		return n;
+	}
+
+	// Consumer side.
+
+	bool try_pop(T & value)
+	{
+		std::size_t head = _consumer.head.load(std::memory_order_relaxed);
+		if (this->_available(head, 1) == 0)
+			return false;
+
+		T & slot = _buf[head & _mask];
+		value = std::move(slot);
+		slot.~T();
+
+		_consumer.head.store(head + 1, std::memory_order_release);
+		return true;
+	}
+
+	// Moves up to `n` elements out of the queue into `out` and returns
+	// their number.
+	template <typename OutputIt>
+	size_type pop_n(OutputIt out, size_type n)
+	{
+		std::size_t head = _consumer.head.load(std::memory_order_relaxed);
+		n = this->_available(head, n);
+
+		std::size_t idx = head & _mask;
+		std::size_t first_run = (std::min)(n, _mask + 1 - idx);
+		out = _move_out(_buf + idx, first_run, out);
+		_move_out(_buf, n - first_run, out);
+
+		_consumer.head.store(head + n, std::memory_order_release);
+		return n;
+	}
+
+private:
+	static size_type _round_up(size_type n) noexcept
+	{
+		size_type r = 1;
+		while (r < n)
+			r *= 2;
+		return r;
+	}
+
+	template <typename OutputIt>
+	static OutputIt _move_out(T * first, std::size_t n, OutputIt out)
+	{
+		out = std::move(first, first + n, out);
+		for (std::size_t i = 0; i != n; ++i)
+			first[i].~T();
+		return out;
+	}
+
+	// Returns how many of `n` elements fit, refreshing the cached head
+	// if the cached value doesn't leave enough room.
+	std::size_t _free(std::size_t tail, std::size_t n) noexcept
+	{
+		std::size_t free = _mask + 1 - (tail - _producer.head_cache);
+		if (free < n)
+		{
+			_producer.head_cache = _consumer.head.load(std::memory_order_acquire);
+			free = _mask + 1 - (tail - _producer.head_cache);
+		}
+
+		return (std::min)(free, n);
+	}
+
+	std::size_t _available(std::size_t head, std::size_t n) noexcept
+	{
+		std::size_t available = _consumer.tail_cache - head;
+		if (available < n)
+		{
+			_consumer.tail_cache = _producer.tail.load(std::memory_order_acquire);
+			available = _consumer.tail_cache - head;
+		}
+
+		return (std::min)(available, n);
+	}
+
+	struct alignas(hardware_destructive_interference_size) _producer_state
+	{
+		atomic<std::size_t> tail;
+		std::size_t head_cache = 0;
+	};
+
+	struct alignas(hardware_destructive_interference_size) _consumer_state
+	{
+		atomic<std::size_t> head;
+		std::size_t tail_cache = 0;
+	};
+
+	std::size_t const _mask;
+	T * const _buf;
+	_producer_state _producer;
+	_consumer_state _consumer;
+};
+
+}
+
+#endif // _h
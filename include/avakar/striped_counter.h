@@ -0,0 +1,131 @@
+#ifndef AVAKAR_STRIPED_COUNTER_h
+#define AVAKAR_STRIPED_COUNTER_h
+
+#include <atomic>
+#include <cstddef>
+#include <type_traits>
+
+#include "atomic_ref.h"
+#include "padded_atomic.h"
+
+namespace avakar {
+
+// A counter that is cheap to increment from many threads at once.
+//
+// The value is split into `shards` parts, each on its own cache line.
+// Modifications go to the shard of the CPU the thread is running on
+// (or of the thread itself, where the CPU can't be queried), so threads
+// on different CPUs don't contend. Reading the value sums all shards;
+// the result is exact once the modifications have stopped, but
+// a concurrent `load` may not correspond to any single point in time.
+//
+// Note that the shards are over-aligned; before C++17, allocating
+// a `striped_counter` on the heap may leave them sharing cache lines.
+
+template <typename T, std::size_t shards = 64>
+struct striped_counter
+{
+	static_assert(std::is_integral<T>::value && !std::is_same<T, bool>::value, "T must be an integral type");
+	static_assert(shards != 0 && (shards & (shards - 1)) == 0, "shards must be a power of two");
+
+	using value_type = T;
+
+	explicit striped_counter() noexcept
+		: _shards()
+	{
+	}
+
+	explicit striped_counter(T desired) noexcept
+		: _shards()
+	{
+		_shards[0].value = desired;
+	}
+
+	striped_counter(striped_counter const &) = delete;
+	striped_counter & operator=(striped_counter const &) = delete;
+
+	void add(T arg) noexcept
+	{
+		atomic_ref<T>(this->_local()).fetch_add(arg, memory_order_relaxed_t());
+	}
+
+	void sub(T arg) noexcept
+	{
+		atomic_ref<T>(this->_local()).fetch_sub(arg, memory_order_relaxed_t());
+	}
+
+	T load(std::memory_order order = std::memory_order_seq_cst) const noexcept
+	{
+		_unsigned_type r = 0;
+		for (_shard const & shard: _shards)
+			r += static_cast<_unsigned_type>(atomic_ref<T>(shard.value).load(order));
+		return static_cast<T>(r);
+	}
+
+	// Zeroes the counter and returns its previous value. No concurrent
+	// modification is lost: each is either counted in the result
+	// or remains in the counter.
+	T reset(std::memory_order order = std::memory_order_seq_cst) noexcept
+	{
+		_unsigned_type r = 0;
+		for (_shard & shard: _shards)
+			r += static_cast<_unsigned_type>(atomic_ref<T>(shard.value).exchange(T(0), order));
+		return static_cast<T>(r);
+	}
+
+	operator T() const noexcept
+	{
+		return this->load();
+	}
+
+	void operator+=(T arg) noexcept
+	{
+		this->add(arg);
+	}
+
+	void operator-=(T arg) noexcept
+	{
+		this->sub(arg);
+	}
+
+	void operator++() noexcept
+	{
+		this->add(1);
+	}
+
+	void operator++(int) noexcept
+	{
+		this->add(1);
+	}
+
+	void operator--() noexcept
+	{
+		this->sub(1);
+	}
+
+	void operator--(int) noexcept
+	{
+		this->sub(1);
+	}
+
+private:
+	// The shards wrap around on overflow, so sum them as unsigned.
+	using _unsigned_type = std::make_unsigned_t<T>;
+
+	// The value is mutable, so that `load` can reference it.
+	struct alignas(hardware_destructive_interference_size) _shard
+	{
+		mutable T value;
+	};
+
+	T & _local() noexcept
+	{
+		return _shards[_avakar::atomic_ref::_cpu_hint() & (shards - 1)].value;
+	}
+
+	_shard _shards[shards];
+};
+
+}
+
+#endif // _h
@@ -0,0 +1,87 @@
+#ifndef AVAKAR_TICKET_LOCK_h
+#define AVAKAR_TICKET_LOCK_h
+
+#include <atomic>
+#include <cstdint>
+
+#include "atomic.h"
+#include "backoff.h"
+
+namespace avakar {
+
+// A fair spinlock. A thread takes a ticket from the high half of the word
+// and waits until the low half, the ticket being served, reaches it.
+// Both halves live in one 32-bit word, so taking a ticket is one
+// `fetch_add` and the waiters only ever read the line until the owner
+// releases it. Waiters back off in proportion to their distance
+// from the head of the line. Up to 65535 threads may wait at once.
+
+struct ticket_lock
+{
+	explicit ticket_lock() noexcept
+		: _word(0)
+	{
+	}
+
+	ticket_lock(ticket_lock const &) = delete;
+	ticket_lock & operator=(ticket_lock const &) = delete;
+
+	bool try_lock() noexcept
+	{
+		std::uint32_t cur = _word.load(std::memory_order_relaxed);
+		if (_serving(cur) != _next(cur))
+			return false;
+
+		return _word.compare_exchange_strong(cur, cur + _ticket, std::memory_order_acquire, std::memory_order_relaxed);
+	}
+
+	void lock() noexcept
+	{
+		std::uint32_t cur = _word.fetch_add(_ticket, std::memory_order_acquire);
+		std::uint16_t ticket = _next(cur);
+
+		for (;;)
+		{
+			std::uint16_t serving = _serving(cur);
+			if (serving == ticket)
+				break;
+
+			std::uint16_t distance = ticket - serving;
+			for (unsigned i = 0; i != distance * _pause_per_waiter; ++i)
+				cpu_relax();
+
+			cur = _word.load(std::memory_order_acquire);
+		}
+	}
+
+	void unlock() noexcept
+	{
+		// Only the owner changes the low half, so it knows whether
+		// the increment would carry into the high half.
+		std::uint32_t cur = _word.load(std::memory_order_relaxed);
+		if (_serving(cur) == 0xffff)
+			_word.fetch_sub(0xffff, std::memory_order_release);
+		else
+			_word.fetch_add(1, std::memory_order_release);
+	}
+
+private:
+	static constexpr std::uint32_t _ticket = 0x10000;
+	static constexpr unsigned _pause_per_waiter = 16;
+
+	static std::uint16_t _serving(std::uint32_t word) noexcept
+	{
+		return static_cast<std::uint16_t>(word);
+	}
+
+	static std::uint16_t _next(std::uint32_t word) noexcept
+	{
+		return static_cast<std::uint16_t>(word >> 16);
+	}
+
+	atomic<std::uint32_t> _word;
+};
+
+}
+
+#endif // _h
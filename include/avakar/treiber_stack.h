@@ -0,0 +1,133 @@
+#ifndef AVAKAR_TREIBER_STACK_h
+#define AVAKAR_TREIBER_STACK_h
+
+#include <atomic>
+#include <cstddef>
+
+#include "atomic.h"
+#include "atomic_tagged_ptr.h"
+#include "backoff.h"
+
+namespace avakar {
+
+// An intrusive lock-free stack after R. Kent Treiber.
+//
+// Elements derive from `treiber_stack_hook`, which holds the link.
+// The head is an `atomic_tagged_ptr`, so a `pop` that loses the race
+// to a `pop` and `push` of the same element fails its CAS instead of
+// corrupting the stack.
+//
+// A popping thread may read the link of an element that another thread
+// has already popped, so the memory of popped elements must stay mapped
+// while the stack is in use. This holds for free lists, whose elements
+// are never returned to the system; to free elements, protect them
+// with hazard pointers or epochs.
+//
+//     struct buffer
+//         : avakar::treiber_stack_hook
+//     {
+//         char data[4096];
+//     };
+//
+//     avakar::treiber_stack<buffer> free_buffers;
+
+struct treiber_stack_hook
+{
+	explicit treiber_stack_hook() noexcept
+		: _next(nullptr)
+	{
+	}
+
+	treiber_stack_hook(treiber_stack_hook const &) = delete;
+	treiber_stack_hook & operator=(treiber_stack_hook const &) = delete;
+
+	atomic<treiber_stack_hook *> _next;
+};
+
+template <typename T>
+struct treiber_stack
+{
+	using value_type = T;
+
+	explicit treiber_stack() noexcept
+		: _head()
+	{
+	}
+
+	treiber_stack(treiber_stack const &) = delete;
+	treiber_stack & operator=(treiber_stack const &) = delete;
+
+	bool empty() const noexcept
+	{
+		return _head.load(std::memory_order_relaxed).ptr() == nullptr;
+	}
+
+	void push(T * elem) noexcept
+	{
+		this->push_list(elem, elem);
+	}
+
+	// Pushes a chain of elements linked through `next`, from `first`
+	// to `last` inclusive, with a single CAS.
+	void push_list(T * first, T * last) noexcept
+	{
+		treiber_stack_hook * hook = last;
+
+		auto cur = _head.load(std::memory_order_relaxed);
+		for (;;)
+		{
+			hook->_next.store(cur.ptr(), std::memory_order_relaxed);
+			if (_head.compare_exchange_weak(cur, first, std::memory_order_release, std::memory_order_relaxed))
+				break;
+			cpu_relax();
+		}
+	}
+
+	// Returns the top element, or null if the stack is empty.
+	T * pop() noexcept
+	{
+		auto cur = _head.load(std::memory_order_acquire);
+		while (cur.ptr() != nullptr)
+		{
+			T * next = treiber_stack::next(cur.ptr());
+			if (_head.compare_exchange_weak(cur, next, std::memory_order_acquire, std::memory_order_acquire))
+				break;
+			cpu_relax();
+		}
+
+		return cur.ptr();
+	}
+
+	// Takes all elements at once; walk them with `next`.
+	T * pop_all() noexcept
+	{
+		auto cur = _head.load(std::memory_order_relaxed);
+		while (cur.ptr() != nullptr
+			&& !_head.compare_exchange_weak(cur, nullptr, std::memory_order_acquire, std::memory_order_relaxed))
+		{
+		}
+
+		return cur.ptr();
+	}
+
+	// The element below `elem`, or null.
+	static T * next(T * elem) noexcept
+	{
+		treiber_stack_hook const * hook = elem;
+		return static_cast<T *>(hook->_next.load(std::memory_order_relaxed));
+	}
+
+	// Links `elem` to `next`, e.g. to build a chain for `push_list`.
+	static void set_next(T * elem, T * next) noexcept
+	{
+		treiber_stack_hook * hook = elem;
+		hook->_next.store(next, std::memory_order_relaxed);
+	}
+
+private:
+	atomic_tagged_ptr<T> _head;
+};
+
+}
+
+#endif // _h
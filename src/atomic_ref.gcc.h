@@ -2,14 +2,48 @@
 #define AVAKAR_ATOMIC_REF_ATOMIC_REF_GCC_h
 
 #include <atomic>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
 #include <type_traits>
 
+#include "atomic_ref.instrument.h"
+
+#if defined(__x86_64__)
+#include <cpuid.h>
+#endif
+
+#if defined(__linux__)
+#include <linux/futex.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#else
+#include <thread>
+#endif
+
 namespace _avakar {
 namespace atomic_ref {
 
+template <typename T>
+struct _is_dwcas
+#if defined(__x86_64__)
+	: std::integral_constant<bool, sizeof(T) == 16>
+#else
+	: std::false_type
+#endif
+{
+};
+
 template <typename T>
 struct is_always_lock_free
-	: std::integral_constant<bool, __atomic_always_lock_free(sizeof(T), 0)>
+	: std::integral_constant<bool, __atomic_always_lock_free(sizeof(T), 0)
+#if defined(__GCC_HAVE_SYNC_COMPARE_AND_SWAP_16)
+		|| _is_dwcas<T>::value
+#endif
+		>
 {
 };
 
@@ -20,71 +54,331 @@ struct is_always_wait_free
 };
 
 template <typename T>
-std::enable_if_t<std::is_enum<T>::value, T> load(T const & obj, std::memory_order order) noexcept
+struct required_alignment
+	: std::integral_constant<std::size_t,
+		((is_always_lock_free<T>::value || _is_dwcas<T>::value) && (sizeof(T) & (sizeof(T) - 1)) == 0 && sizeof(T) > alignof(T)
+			? sizeof(T)
+			: alignof(T))>
+{
+};
+
+// Lock-free objects go to the __atomic builtins, 16-byte objects on x86-64
+// to cmpxchg16b, and everything else to the lock table.
+
+template <typename T, typename R = void>
+using _lock_free_t = std::enable_if_t<is_always_lock_free<T>::value && !_is_dwcas<T>::value, R>;
+
+template <typename T, typename R = void>
+using _dwcas_t = std::enable_if_t<_is_dwcas<T>::value, R>;
+
+template <typename T, typename R = void>
+using _locked_t = std::enable_if_t<!is_always_lock_free<T>::value && !_is_dwcas<T>::value, R>;
+
+#if (defined(__aarch64__) && defined(__APPLE__)) || defined(__powerpc64__)
+constexpr std::size_t cache_line_size = 128;
+#elif defined(__s390x__)
+constexpr std::size_t cache_line_size = 256;
+#else
+constexpr std::size_t cache_line_size = 64;
+#endif
+
+inline void cpu_relax() noexcept
+{
+#if defined(__i386__) || defined(__x86_64__)
+	__builtin_ia32_pause();
+#elif defined(__aarch64__)
+	__asm__ __volatile__("yield");
+#endif
+}
+
+// Returns the index of the CPU the calling thread is running on,
+// or a per-thread number where that's not available. The result is
+// only a hint: the thread may migrate at any time.
+inline std::size_t _cpu_hint() noexcept
+{
+#if defined(__linux__)
+	int cpu = sched_getcpu();
+	if (cpu >= 0)
+		return static_cast<std::size_t>(cpu);
+#endif
+
+	static std::atomic<std::size_t> next_thread{ 0 };
+	static thread_local std::size_t thread = next_thread.fetch_add(1, std::memory_order_relaxed);
+	return thread;
+}
+
+// Objects that are not lock-free are protected by a striped lock.
+// The stripe is chosen by hashing the object's address and each stripe
+// lives on its own cache line, so that unrelated objects rarely contend.
+// The stripe count can be overridden by defining
+// `AVAKAR_ATOMIC_REF_LOCK_STRIPES` to a power of two.
+
+#ifndef AVAKAR_ATOMIC_REF_LOCK_STRIPES
+#define AVAKAR_ATOMIC_REF_LOCK_STRIPES 64
+#endif
+
+static_assert(AVAKAR_ATOMIC_REF_LOCK_STRIPES > 0
+	&& (AVAKAR_ATOMIC_REF_LOCK_STRIPES & (AVAKAR_ATOMIC_REF_LOCK_STRIPES - 1)) == 0,
+	"AVAKAR_ATOMIC_REF_LOCK_STRIPES must be a power of two");
+
+struct _lock_stripe
+{
+	alignas(cache_line_size) unsigned int seq;
+};
+
+template <typename = void>
+struct _lock_table
+{
+	static _lock_stripe stripes[AVAKAR_ATOMIC_REF_LOCK_STRIPES];
+};
+
+template <typename D>
+_lock_stripe _lock_table<D>::stripes[AVAKAR_ATOMIC_REF_LOCK_STRIPES];
+
+inline _lock_stripe & _lock_stripe_for(void const * addr) noexcept
+{
+	std::uintptr_t h = reinterpret_cast<std::uintptr_t>(addr) >> 3;
+	h ^= h >> 7;
+	h ^= h >> 17;
+	return _lock_table<>::stripes[h & (AVAKAR_ATOMIC_REF_LOCK_STRIPES - 1)];
+}
+
+// The stripe's `seq` is odd while the stripe is locked.
+struct _stripe_lock
+{
+	// A `seq_cst` operation also issues a full fence after the unlock,
+	// so that it isn't reordered with the caller's subsequent
+	// `seq_cst` operations on other objects.
+	explicit _stripe_lock(void const * addr, std::memory_order order = std::memory_order_relaxed) noexcept
+		: _stripe(_lock_stripe_for(addr)), _seq_cst(order == std::memory_order_seq_cst)
+	{
+		_seq = __atomic_load_n(&_stripe.seq, __ATOMIC_RELAXED);
+		for (;;)
+		{
+			if ((_seq & 1) == 0
+				&& __atomic_compare_exchange_n(&_stripe.seq, &_seq, _seq + 1, true, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED))
+			{
+				break;
+			}
+
+			record(event::retry);
+			cpu_relax();
+			_seq = __atomic_load_n(&_stripe.seq, __ATOMIC_RELAXED);
+		}
+
+		// Orders the stores to the object after the odd `seq`
+		// for the benefit of optimistic readers.
+		__atomic_thread_fence(__ATOMIC_RELEASE);
+	}
+
+	~_stripe_lock()
+	{
+		__atomic_store_n(&_stripe.seq, _seq + 2, __ATOMIC_RELEASE);
+		if (_seq_cst)
+			__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	}
+
+	_stripe_lock(_stripe_lock const &) = delete;
+	_stripe_lock & operator=(_stripe_lock const &) = delete;
+
+private:
+	_lock_stripe & _stripe;
+	unsigned int _seq;
+	bool _seq_cst;
+};
+
+template <typename T>
+std::enable_if_t<std::is_enum<T>::value, _lock_free_t<T, T>> load(T const & obj, std::memory_order order) noexcept
 {
 	return (T)__atomic_load_n((std::underlying_type_t<T> const *)&obj, order);
 }
 
 template <typename T>
-std::enable_if_t<!std::is_enum<T>::value, T> load(T const & obj, std::memory_order order) noexcept
+std::enable_if_t<std::is_integral<T>::value || std::is_pointer<T>::value, _lock_free_t<T, T>> load(T const & obj, std::memory_order order) noexcept
 {
 	return __atomic_load_n(&obj, order);
 }
 
 template <typename T>
-void store(T & obj, T desired, std::memory_order order) noexcept
+std::enable_if_t<!std::is_integral<T>::value && !std::is_pointer<T>::value && !std::is_enum<T>::value, _lock_free_t<T, T>> load(T const & obj, std::memory_order order) noexcept
+{
+	std::aligned_storage_t<sizeof(T), alignof(T)> r;
+	__atomic_load(&obj, reinterpret_cast<T *>(&r), order);
+	return reinterpret_cast<T &>(r);
+}
+
+template <typename T>
+_lock_free_t<T> store(T & obj, T desired, std::memory_order order) noexcept
 {
 	__atomic_store(&obj, &desired, order);
 }
 
 template <typename T>
-T exchange(T & obj, T desired, std::memory_order order) noexcept
+_lock_free_t<T, T> exchange(T & obj, T desired, std::memory_order order) noexcept
 {
-	return __atomic_exchange_n(&obj, desired, order);
+	std::aligned_storage_t<sizeof(T), alignof(T)> r;
+	__atomic_exchange(&obj, &desired, reinterpret_cast<T *>(&r), order);
+	return reinterpret_cast<T &>(r);
 }
 
 template <typename T>
-bool compare_exchange_weak(T & obj, T & expected, T desired, std::memory_order success, std::memory_order failure) noexcept
+_lock_free_t<T, bool> compare_exchange_weak(T & obj, T & expected, T desired, std::memory_order success, std::memory_order failure) noexcept
 {
 	return __atomic_compare_exchange(&obj, &expected, &desired, true, success, failure);
 }
 
 template <typename T>
-bool compare_exchange_strong(T & obj, T & expected, T desired, std::memory_order success, std::memory_order failure) noexcept
+_lock_free_t<T, bool> compare_exchange_strong(T & obj, T & expected, T desired, std::memory_order success, std::memory_order failure) noexcept
 {
 	return __atomic_compare_exchange(&obj, &expected, &desired, false, success, failure);
 }
 
 template <typename T>
-T fetch_add(T & obj, T arg, std::memory_order order) noexcept
+std::enable_if_t<!std::is_floating_point<T>::value, _lock_free_t<T, T>> fetch_add(T & obj, T arg, std::memory_order order) noexcept
 {
 	return __atomic_fetch_add(&obj, arg, order);
 }
 
 template <typename T>
-T fetch_sub(T & obj, T arg, std::memory_order order) noexcept
+std::enable_if_t<!std::is_floating_point<T>::value, _lock_free_t<T, T>> fetch_sub(T & obj, T arg, std::memory_order order) noexcept
 {
 	return __atomic_fetch_sub(&obj, arg, order);
 }
 
 template <typename T>
-T fetch_and(T & obj, T arg, std::memory_order order) noexcept
+_lock_free_t<T, T> fetch_and(T & obj, T arg, std::memory_order order) noexcept
 {
 	return __atomic_fetch_and(&obj, arg, order);
 }
 
 template <typename T>
-T fetch_or(T & obj, T arg, std::memory_order order) noexcept
+_lock_free_t<T, T> fetch_or(T & obj, T arg, std::memory_order order) noexcept
 {
 	return __atomic_fetch_or(&obj, arg, order);
 }
 
 template <typename T>
-T fetch_xor(T & obj, T arg, std::memory_order order) noexcept
+_lock_free_t<T, T> fetch_xor(T & obj, T arg, std::memory_order order) noexcept
+{
+	return __atomic_fetch_xor(&obj, arg, order);
+}
+
+// Overloads taking the memory order as a type, so that the builtins
+// see a constant even when the call isn't inlined.
+
+template <std::memory_order order>
+using _order_t = std::integral_constant<std::memory_order, order>;
+
+template <typename T, std::memory_order order>
+std::enable_if_t<std::is_enum<T>::value, _lock_free_t<T, T>> load(T const & obj, _order_t<order>) noexcept
+{
+	return (T)__atomic_load_n((std::underlying_type_t<T> const *)&obj, order);
+}
+
+template <typename T, std::memory_order order>
+std::enable_if_t<std::is_integral<T>::value || std::is_pointer<T>::value, _lock_free_t<T, T>> load(T const & obj, _order_t<order>) noexcept
+{
+	return __atomic_load_n(&obj, order);
+}
+
+template <typename T, std::memory_order order>
+std::enable_if_t<!std::is_integral<T>::value && !std::is_pointer<T>::value && !std::is_enum<T>::value, _lock_free_t<T, T>> load(T const & obj, _order_t<order>) noexcept
+{
+	std::aligned_storage_t<sizeof(T), alignof(T)> r;
+	__atomic_load(&obj, reinterpret_cast<T *>(&r), order);
+	return reinterpret_cast<T &>(r);
+}
+
+template <typename T, std::memory_order order>
+_lock_free_t<T> store(T & obj, T desired, _order_t<order>) noexcept
+{
+	__atomic_store(&obj, &desired, order);
+}
+
+template <typename T, std::memory_order order>
+_lock_free_t<T, T> exchange(T & obj, T desired, _order_t<order>) noexcept
+{
+	std::aligned_storage_t<sizeof(T), alignof(T)> r;
+	__atomic_exchange(&obj, &desired, reinterpret_cast<T *>(&r), order);
+	return reinterpret_cast<T &>(r);
+}
+
+template <typename T, std::memory_order success, std::memory_order failure>
+_lock_free_t<T, bool> compare_exchange_weak(T & obj, T & expected, T desired, _order_t<success>, _order_t<failure>) noexcept
+{
+	return __atomic_compare_exchange(&obj, &expected, &desired, true, success, failure);
+}
+
+template <typename T, std::memory_order success, std::memory_order failure>
+_lock_free_t<T, bool> compare_exchange_strong(T & obj, T & expected, T desired, _order_t<success>, _order_t<failure>) noexcept
+{
+	return __atomic_compare_exchange(&obj, &expected, &desired, false, success, failure);
+}
+
+template <typename T, std::memory_order order>
+std::enable_if_t<!std::is_floating_point<T>::value, _lock_free_t<T, T>> fetch_add(T & obj, T arg, _order_t<order>) noexcept
+{
+	return __atomic_fetch_add(&obj, arg, order);
+}
+
+template <typename T, std::memory_order order>
+std::enable_if_t<!std::is_floating_point<T>::value, _lock_free_t<T, T>> fetch_sub(T & obj, T arg, _order_t<order>) noexcept
+{
+	return __atomic_fetch_sub(&obj, arg, order);
+}
+
+template <typename T, std::memory_order order>
+_lock_free_t<T, T> fetch_and(T & obj, T arg, _order_t<order>) noexcept
+{
+	return __atomic_fetch_and(&obj, arg, order);
+}
+
+template <typename T, std::memory_order order>
+_lock_free_t<T, T> fetch_or(T & obj, T arg, _order_t<order>) noexcept
+{
+	return __atomic_fetch_or(&obj, arg, order);
+}
+
+template <typename T, std::memory_order order>
+_lock_free_t<T, T> fetch_xor(T & obj, T arg, _order_t<order>) noexcept
 {
 	return __atomic_fetch_xor(&obj, arg, order);
 }
 
+template <typename T, std::memory_order order>
+auto fetch_add(T * & obj, std::ptrdiff_t arg, _order_t<order>) noexcept
+{
+	return __atomic_fetch_add(&obj, arg * sizeof(T), order);
+}
+
+template <typename T, std::memory_order order>
+auto fetch_sub(T * & obj, std::ptrdiff_t arg, _order_t<order>) noexcept
+{
+	return __atomic_fetch_sub(&obj, arg * sizeof(T), order);
+}
+
+template <typename T>
+std::enable_if_t<std::is_floating_point<T>::value, _lock_free_t<T, T>> fetch_add(T & obj, T arg, std::memory_order order) noexcept
+{
+	T cur = load(obj, std::memory_order_relaxed);
+	while (!compare_exchange_weak(obj, cur, T(cur + arg), order, std::memory_order_relaxed))
+	{
+		record(event::retry);
+	}
+	return cur;
+}
+
+template <typename T>
+std::enable_if_t<std::is_floating_point<T>::value, _lock_free_t<T, T>> fetch_sub(T & obj, T arg, std::memory_order order) noexcept
+{
+	T cur = load(obj, std::memory_order_relaxed);
+	while (!compare_exchange_weak(obj, cur, T(cur - arg), order, std::memory_order_relaxed))
+	{
+		record(event::retry);
+	}
+	return cur;
+}
+
 template <typename T>
 auto fetch_add(T * & obj, std::ptrdiff_t arg, std::memory_order order) noexcept
 {
@@ -97,6 +391,686 @@ auto fetch_sub(T * & obj, std::ptrdiff_t arg, std::memory_order order) noexcept
 	return __atomic_fetch_sub(&obj, arg * sizeof(T), order);
 }
 
+// Stores to locked objects are performed word by word using relaxed atomics,
+// so that they may race with the optimistic readers below.
+
+template <typename T>
+using _seq_word_t = std::conditional_t<
+	alignof(T) % sizeof(std::uintptr_t) == 0 && sizeof(T) % sizeof(std::uintptr_t) == 0, std::uintptr_t,
+	std::conditional_t<alignof(T) % 4 == 0 && sizeof(T) % 4 == 0, std::uint32_t,
+	std::conditional_t<alignof(T) % 2 == 0 && sizeof(T) % 2 == 0, std::uint16_t,
+	unsigned char>>>;
+
+template <typename T>
+T _seq_read(T const & obj) noexcept
+{
+	using word_t = _seq_word_t<T>;
+
+	word_t const * src = reinterpret_cast<word_t const *>(&obj);
+	word_t buf[sizeof(T) / sizeof(word_t)];
+	for (std::size_t i = 0; i != sizeof(T) / sizeof(word_t); ++i)
+		buf[i] = __atomic_load_n(src + i, __ATOMIC_RELAXED);
+
+	std::aligned_storage_t<sizeof(T), alignof(T)> r;
+	std::memcpy(&r, buf, sizeof(T));
+	return reinterpret_cast<T &>(r);
+}
+
+template <typename T>
+void _seq_write(T & obj, T const & value) noexcept
+{
+	using word_t = _seq_word_t<T>;
+
+	word_t buf[sizeof(T) / sizeof(word_t)];
+	std::memcpy(buf, &value, sizeof(T));
+
+	word_t * dst = reinterpret_cast<word_t *>(&obj);
+	for (std::size_t i = 0; i != sizeof(T) / sizeof(word_t); ++i)
+		__atomic_store_n(dst + i, buf[i], __ATOMIC_RELAXED);
+}
+
+// Unless `AVAKAR_ATOMIC_REF_SEQLOCK` is defined to 0, loads of locked
+// objects never write to the stripe. The stripe is used as a sequence lock
+// instead: the value is copied and the copy is retried if a writer
+// held the stripe at any point during the copy.
+
+#ifndef AVAKAR_ATOMIC_REF_SEQLOCK
+#define AVAKAR_ATOMIC_REF_SEQLOCK 1
+#endif
+
+template <typename T>
+T _locked_load(T const & obj, std::memory_order order) noexcept
+{
+	// Neither the snapshot nor the stripe lock orders the load after
+	// the caller's preceding `seq_cst` stores to other objects.
+	if (order == std::memory_order_seq_cst)
+		__atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+#if AVAKAR_ATOMIC_REF_SEQLOCK
+	_lock_stripe & stripe = _lock_stripe_for(&obj);
+	for (;;)
+	{
+		unsigned int seq = __atomic_load_n(&stripe.seq, __ATOMIC_ACQUIRE);
+		if ((seq & 1) == 0)
+		{
+			T r = _seq_read(obj);
+			__atomic_thread_fence(__ATOMIC_ACQUIRE);
+			if (__atomic_load_n(&stripe.seq, __ATOMIC_RELAXED) == seq)
+				return r;
+		}
+
+		record(event::retry);
+		cpu_relax();
+	}
+#else
+	_stripe_lock lock(&obj);
+	return obj;
+#endif
+}
+
+template <typename T>
+void _locked_store(T & obj, T desired, std::memory_order order) noexcept
+{
+	_stripe_lock lock(&obj, order);
+	_seq_write(obj, desired);
+}
+
+template <typename T>
+T _locked_exchange(T & obj, T desired, std::memory_order order) noexcept
+{
+	_stripe_lock lock(&obj, order);
+	T r = obj;
+	_seq_write(obj, desired);
+	return r;
+}
+
+template <typename T>
+bool _locked_compare_exchange(T & obj, T & expected, T desired, std::memory_order success, std::memory_order failure) noexcept
+{
+#if AVAKAR_ATOMIC_REF_SEQLOCK
+	// A snapshot that differs from `expected` is a valid outcome of a failed
+	// exchange, and getting it doesn't require taking the lock.
+	T cur = _locked_load(obj, failure);
+	if (std::memcmp(&cur, &expected, sizeof(T)) != 0)
+	{
+		expected = cur;
+		return false;
+	}
+#else
+	(void)failure;
+#endif
+
+	_stripe_lock lock(&obj, success);
+	if (std::memcmp(&obj, &expected, sizeof(T)) != 0)
+	{
+		expected = obj;
+		return false;
+	}
+
+	_seq_write(obj, desired);
+	return true;
+}
+
+template <typename T>
+T _locked_fetch_add(T & obj, T arg, std::memory_order order) noexcept
+{
+	_stripe_lock lock(&obj, order);
+	T r = obj;
+	_seq_write(obj, T(r + arg));
+	return r;
+}
+
+template <typename T>
+T _locked_fetch_sub(T & obj, T arg, std::memory_order order) noexcept
+{
+	_stripe_lock lock(&obj, order);
+	T r = obj;
+	_seq_write(obj, T(r - arg));
+	return r;
+}
+
+template <typename T>
+T _locked_fetch_and(T & obj, T arg, std::memory_order order) noexcept
+{
+	_stripe_lock lock(&obj, order);
+	T r = obj;
+	_seq_write(obj, T(r & arg));
+	return r;
+}
+
+template <typename T>
+T _locked_fetch_or(T & obj, T arg, std::memory_order order) noexcept
+{
+	_stripe_lock lock(&obj, order);
+	T r = obj;
+	_seq_write(obj, T(r | arg));
+	return r;
+}
+
+template <typename T>
+T _locked_fetch_xor(T & obj, T arg, std::memory_order order) noexcept
+{
+	_stripe_lock lock(&obj, order);
+	T r = obj;
+	_seq_write(obj, T(r ^ arg));
+	return r;
+}
+
+template <typename T>
+_locked_t<T, T> load(T const & obj, std::memory_order order) noexcept
+{
+	return _locked_load(obj, order);
+}
+
+template <typename T>
+_locked_t<T> store(T & obj, T desired, std::memory_order order) noexcept
+{
+	_locked_store(obj, desired, order);
+}
+
+template <typename T>
+_locked_t<T, T> exchange(T & obj, T desired, std::memory_order order) noexcept
+{
+	return _locked_exchange(obj, desired, order);
+}
+
+template <typename T>
+_locked_t<T, bool> compare_exchange_weak(T & obj, T & expected, T desired, std::memory_order success, std::memory_order failure) noexcept
+{
+	return _locked_compare_exchange(obj, expected, desired, success, failure);
+}
+
+template <typename T>
+_locked_t<T, bool> compare_exchange_strong(T & obj, T & expected, T desired, std::memory_order success, std::memory_order failure) noexcept
+{
+	return _locked_compare_exchange(obj, expected, desired, success, failure);
+}
+
+template <typename T>
+_locked_t<T, T> fetch_add(T & obj, T arg, std::memory_order order) noexcept
+{
+	return _locked_fetch_add(obj, arg, order);
+}
+
+template <typename T>
+_locked_t<T, T> fetch_sub(T & obj, T arg, std::memory_order order) noexcept
+{
+	return _locked_fetch_sub(obj, arg, order);
+}
+
+template <typename T>
+_locked_t<T, T> fetch_and(T & obj, T arg, std::memory_order order) noexcept
+{
+	return _locked_fetch_and(obj, arg, order);
+}
+
+template <typename T>
+_locked_t<T, T> fetch_or(T & obj, T arg, std::memory_order order) noexcept
+{
+	return _locked_fetch_or(obj, arg, order);
+}
+
+template <typename T>
+_locked_t<T, T> fetch_xor(T & obj, T arg, std::memory_order order) noexcept
+{
+	return _locked_fetch_xor(obj, arg, order);
+}
+
+#if defined(__x86_64__)
+
+// 16-byte objects use `lock cmpxchg16b` directly; GCC would otherwise
+// forward them to libatomic even with -mcx16. The very first x86-64 CPUs
+// lack the instruction, so unless the compiler was told it's available,
+// support is detected at runtime and the lock table is used as a fallback.
+
+struct _dwcas_word
+{
+	std::uint64_t lo;
+	std::uint64_t hi;
+};
+
+template <typename = void>
+struct _cmpxchg16b_support
+{
+	static int state;
+};
+
+template <typename D>
+int _cmpxchg16b_support<D>::state;
+
+inline bool _has_cmpxchg16b() noexcept
+{
+#if defined(__GCC_HAVE_SYNC_COMPARE_AND_SWAP_16)
+	return true;
+#else
+	int state = __atomic_load_n(&_cmpxchg16b_support<>::state, __ATOMIC_RELAXED);
+	if (state == 0)
+	{
+		unsigned int eax, ebx, ecx, edx;
+		bool supported = __get_cpuid(1, &eax, &ebx, &ecx, &edx) && (ecx & bit_CMPXCHG16B) != 0;
+		state = supported? 1: 2;
+		__atomic_store_n(&_cmpxchg16b_support<>::state, state, __ATOMIC_RELAXED);
+	}
+
+	return state == 1;
+#endif
+}
+
+// cmpxchg16b faults unless its operand is 16-aligned. `required_alignment`
+// asks for that, but an 8-aligned object, such as a member of a struct,
+// is locked instead of crashing.
+inline bool _can_cmpxchg16b(void const * obj) noexcept
+{
+	return (reinterpret_cast<std::uintptr_t>(obj) & 15) == 0 && _has_cmpxchg16b();
+}
+
+inline bool _cmpxchg16b(void * obj, void * expected, void const * desired) noexcept
+{
+	_dwcas_word exp, des;
+	std::memcpy(&exp, expected, sizeof exp);
+	std::memcpy(&des, desired, sizeof des);
+
+	bool r;
+	__asm__ __volatile__(
+		"lock cmpxchg16b %1\n\t"
+		"sete %0"
+		: "=q"(r), "+m"(*static_cast<_dwcas_word *>(obj)), "+a"(exp.lo), "+d"(exp.hi)
+		: "b"(des.lo), "c"(des.hi)
+		: "memory", "cc");
+
+	std::memcpy(expected, &exp, sizeof exp);
+	return r;
+}
+
+template <typename T, typename F>
+T _cmpxchg16b_rmw(T & obj, F f) noexcept
+{
+	// The first attempt merely guesses that the object is zero.
+	std::aligned_storage_t<sizeof(T), alignof(T)> cur = {};
+	T desired = f(reinterpret_cast<T &>(cur));
+	if (_cmpxchg16b(&obj, &cur, &desired))
+		return reinterpret_cast<T &>(cur);
+
+	for (;;)
+	{
+		desired = f(reinterpret_cast<T &>(cur));
+		if (_cmpxchg16b(&obj, &cur, &desired))
+			return reinterpret_cast<T &>(cur);
+		record(event::retry);
+	}
+}
+
+template <typename T>
+_dwcas_t<T, T> load(T const & obj, std::memory_order order) noexcept
+{
+	if (!_can_cmpxchg16b(&obj))
+		return _locked_load(obj, order);
+
+	// There's no 16-byte load, so we write the value we've just read.
+	// The cache line is thus taken exclusive and the load faults
+	// on read-only memory.
+	std::aligned_storage_t<sizeof(T), alignof(T)> r = {};
+	_cmpxchg16b(const_cast<T *>(&obj), &r, &r);
+	return reinterpret_cast<T &>(r);
+}
+
+template <typename T>
+_dwcas_t<T> store(T & obj, T desired, std::memory_order order) noexcept
+{
+	if (!_can_cmpxchg16b(&obj))
+		return _locked_store(obj, desired, order);
+
+	_cmpxchg16b_rmw(obj, [&](T const &) { return desired; });
+}
+
+template <typename T>
+_dwcas_t<T, T> exchange(T & obj, T desired, std::memory_order order) noexcept
+{
+	if (!_can_cmpxchg16b(&obj))
+		return _locked_exchange(obj, desired, order);
+
+	return _cmpxchg16b_rmw(obj, [&](T const &) { return desired; });
+}
+
+template <typename T>
+_dwcas_t<T, bool> compare_exchange_strong(T & obj, T & expected, T desired, std::memory_order success, std::memory_order failure) noexcept
+{
+	if (!_can_cmpxchg16b(&obj))
+		return _locked_compare_exchange(obj, expected, desired, success, failure);
+
+	return _cmpxchg16b(&obj, &expected, &desired);
+}
+
+template <typename T>
+_dwcas_t<T, bool> compare_exchange_weak(T & obj, T & expected, T desired, std::memory_order success, std::memory_order failure) noexcept
+{
+	return compare_exchange_strong(obj, expected, desired, success, failure);
+}
+
+template <typename T>
+_dwcas_t<T, T> fetch_add(T & obj, T arg, std::memory_order order) noexcept
+{
+	if (!_can_cmpxchg16b(&obj))
+		return _locked_fetch_add(obj, arg, order);
+
+	return _cmpxchg16b_rmw(obj, [&](T const & cur) { return T(cur + arg); });
+}
+
+template <typename T>
+_dwcas_t<T, T> fetch_sub(T & obj, T arg, std::memory_order order) noexcept
+{
+	if (!_can_cmpxchg16b(&obj))
+		return _locked_fetch_sub(obj, arg, order);
+
+	return _cmpxchg16b_rmw(obj, [&](T const & cur) { return T(cur - arg); });
+}
+
+template <typename T>
+_dwcas_t<T, T> fetch_and(T & obj, T arg, std::memory_order order) noexcept
+{
+	if (!_can_cmpxchg16b(&obj))
+		return _locked_fetch_and(obj, arg, order);
+
+	return _cmpxchg16b_rmw(obj, [&](T const & cur) { return T(cur & arg); });
+}
+
+template <typename T>
+_dwcas_t<T, T> fetch_or(T & obj, T arg, std::memory_order order) noexcept
+{
+	if (!_can_cmpxchg16b(&obj))
+		return _locked_fetch_or(obj, arg, order);
+
+	return _cmpxchg16b_rmw(obj, [&](T const & cur) { return T(cur | arg); });
+}
+
+template <typename T>
+_dwcas_t<T, T> fetch_xor(T & obj, T arg, std::memory_order order) noexcept
+{
+	if (!_can_cmpxchg16b(&obj))
+		return _locked_fetch_xor(obj, arg, order);
+
+	return _cmpxchg16b_rmw(obj, [&](T const & cur) { return T(cur ^ arg); });
+}
+
+#endif
+
+constexpr std::memory_order _load_order(std::memory_order order) noexcept
+{
+	return order == std::memory_order_release? std::memory_order_relaxed
+		: order == std::memory_order_acq_rel? std::memory_order_acquire
+		: order;
+}
+
+// When the current value already dominates `arg`, nothing is written
+// and the operation is just a load.
+
+template <typename T>
+T fetch_max(T & obj, T arg, std::memory_order order) noexcept
+{
+	T cur = load(obj, _load_order(order));
+	while (std::less<T>()(cur, arg) && !compare_exchange_weak(obj, cur, arg, order, _load_order(order)))
+	{
+		record(event::retry);
+	}
+	return cur;
+}
+
+template <typename T>
+T fetch_min(T & obj, T arg, std::memory_order order) noexcept
+{
+	T cur = load(obj, _load_order(order));
+	while (std::less<T>()(arg, cur) && !compare_exchange_weak(obj, cur, arg, order, _load_order(order)))
+	{
+		record(event::retry);
+	}
+	return cur;
+}
+
+// As with the immediate form of `bt*`, the bit index is taken modulo
+// the width of T; the register form with a memory operand would reach
+// past the object.
+template <typename T>
+unsigned int _bit_index(unsigned int bit) noexcept
+{
+	return bit & (sizeof(T) * CHAR_BIT - 1);
+}
+
+template <typename T>
+T _bit_mask(unsigned int bit) noexcept
+{
+	return static_cast<T>(std::make_unsigned_t<T>(1) << _bit_index<T>(bit));
+}
+
+template <typename T>
+struct _has_lock_bt
+	: std::integral_constant<bool, is_always_lock_free<T>::value && !_is_dwcas<T>::value
+#if defined(__x86_64__)
+		&& (sizeof(T) == 2 || sizeof(T) == 4 || sizeof(T) == 8)>
+#elif defined(__i386__)
+		&& (sizeof(T) == 2 || sizeof(T) == 4)>
+#else
+		&& false>
+#endif
+{
+};
+
+#if defined(__i386__) || defined(__x86_64__)
+
+// GCC only recognizes `fetch_or(mask) & mask` as `lock bts` in some
+// contexts, so we spell the instructions out.
+
+template <typename T>
+std::enable_if_t<_has_lock_bt<T>::value, bool> bit_test_and_set(T & obj, unsigned int bit, std::memory_order order) noexcept
+{
+	(void)order;
+
+	bool r;
+	__asm__ __volatile__(
+		"lock bts%z1 %2, %1\n\t"
+		"setc %0"
+		: "=q"(r), "+m"(obj)
+		: "Ir"(static_cast<T>(_bit_index<T>(bit)))
+		: "memory", "cc");
+	return r;
+}
+
+template <typename T>
+std::enable_if_t<_has_lock_bt<T>::value, bool> bit_test_and_reset(T & obj, unsigned int bit, std::memory_order order) noexcept
+{
+	(void)order;
+
+	bool r;
+	__asm__ __volatile__(
+		"lock btr%z1 %2, %1\n\t"
+		"setc %0"
+		: "=q"(r), "+m"(obj)
+		: "Ir"(static_cast<T>(_bit_index<T>(bit)))
+		: "memory", "cc");
+	return r;
+}
+
+template <typename T>
+std::enable_if_t<_has_lock_bt<T>::value, bool> bit_test_and_complement(T & obj, unsigned int bit, std::memory_order order) noexcept
+{
+	(void)order;
+
+	bool r;
+	__asm__ __volatile__(
+		"lock btc%z1 %2, %1\n\t"
+		"setc %0"
+		: "=q"(r), "+m"(obj)
+		: "Ir"(static_cast<T>(_bit_index<T>(bit)))
+		: "memory", "cc");
+	return r;
+}
+
+#endif
+
+template <typename T>
+std::enable_if_t<!_has_lock_bt<T>::value, bool> bit_test_and_set(T & obj, unsigned int bit, std::memory_order order) noexcept
+{
+	T mask = _bit_mask<T>(bit);
+	return (fetch_or(obj, mask, order) & mask) != 0;
+}
+
+template <typename T>
+std::enable_if_t<!_has_lock_bt<T>::value, bool> bit_test_and_reset(T & obj, unsigned int bit, std::memory_order order) noexcept
+{
+	T mask = _bit_mask<T>(bit);
+	return (fetch_and(obj, T(~mask), order) & mask) != 0;
+}
+
+template <typename T>
+std::enable_if_t<!_has_lock_bt<T>::value, bool> bit_test_and_complement(T & obj, unsigned int bit, std::memory_order order) noexcept
+{
+	T mask = _bit_mask<T>(bit);
+	return (fetch_xor(obj, mask, order) & mask) != 0;
+}
+
+template <typename T>
+bool is_lock_free() noexcept
+{
+#if defined(__x86_64__)
+	if (_is_dwcas<T>::value)
+		return _has_cmpxchg16b();
+#endif
+	return is_always_lock_free<T>::value;
+}
+
+struct _wait_slot
+{
+	alignas(cache_line_size) unsigned int version;
+	unsigned int waiters;
+};
+
+template <typename = void>
+struct _wait_table
+{
+	static _wait_slot slots[256];
+};
+
+template <typename D>
+_wait_slot _wait_table<D>::slots[256];
+
+inline _wait_slot & _wait_slot_for(void const * addr) noexcept
+{
+	std::uintptr_t h = reinterpret_cast<std::uintptr_t>(addr) >> 2;
+	h ^= h >> 8;
+	h ^= h >> 16;
+	return _wait_table<>::slots[h % 256];
+}
+
+inline void _futex_wait(void const * addr, unsigned int val) noexcept
+{
+#if defined(__linux__)
+	syscall(SYS_futex, addr, FUTEX_WAIT_PRIVATE, val, nullptr, nullptr, 0);
+#else
+	(void)addr;
+	(void)val;
+	std::this_thread::yield();
+#endif
+}
+
+inline void _futex_wake(void const * addr, int count) noexcept
+{
+#if defined(__linux__)
+	syscall(SYS_futex, addr, FUTEX_WAKE_PRIVATE, count, nullptr, nullptr, 0);
+#else
+	(void)addr;
+	(void)count;
+#endif
+}
+
+// 4-byte objects are futex words themselves; waiters block directly on them.
+// Everything else blocks on the version counter of the hashed slot,
+// which is bumped by every notification that finds the slot occupied.
+
+template <typename T>
+auto _wait_block(T const & obj, T old, _wait_slot & slot, unsigned int version) noexcept
+	-> std::enable_if_t<sizeof(T) == 4>
+{
+	(void)slot;
+	(void)version;
+
+	unsigned int val;
+	std::memcpy(&val, &old, sizeof val);
+	_futex_wait(&obj, val);
+}
+
+template <typename T>
+auto _wait_block(T const & obj, T old, _wait_slot & slot, unsigned int version) noexcept
+	-> std::enable_if_t<sizeof(T) != 4>
+{
+	(void)obj;
+	(void)old;
+	_futex_wait(&slot.version, version);
+}
+
+template <typename T>
+auto _wake(T const & obj, _wait_slot & slot, int count) noexcept
+	-> std::enable_if_t<sizeof(T) == 4>
+{
+	(void)slot;
+	_futex_wake(&obj, count);
+}
+
+template <typename T>
+auto _wake(T const & obj, _wait_slot & slot, int count) noexcept
+	-> std::enable_if_t<sizeof(T) != 4>
+{
+	(void)obj;
+	(void)count;
+	__atomic_fetch_add(&slot.version, 1, __ATOMIC_RELAXED);
+	_futex_wake(&slot.version, INT_MAX);
+}
+
+template <typename T>
+void wait(T const & obj, T old, std::memory_order order) noexcept
+{
+	_wait_slot & slot = _wait_slot_for(&obj);
+
+	__atomic_fetch_add(&slot.waiters, 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+	for (;;)
+	{
+		unsigned int version = __atomic_load_n(&slot.version, __ATOMIC_ACQUIRE);
+
+		T cur = load(obj, order);
+		if (std::memcmp(&cur, &old, sizeof(T)) != 0)
+			break;
+
+		record(event::wait);
+		_wait_block(obj, old, slot, version);
+	}
+
+	__atomic_fetch_sub(&slot.waiters, 1, __ATOMIC_RELAXED);
+}
+
+template <typename T>
+void notify_one(T const & obj) noexcept
+{
+	_wait_slot & slot = _wait_slot_for(&obj);
+
+	record(event::notify);
+
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	if (__atomic_load_n(&slot.waiters, __ATOMIC_RELAXED) != 0)
+		_wake(obj, slot, 1);
+}
+
+template <typename T>
+void notify_all(T const & obj) noexcept
+{
+	_wait_slot & slot = _wait_slot_for(&obj);
+
+	record(event::notify);
+
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	if (__atomic_load_n(&slot.waiters, __ATOMIC_RELAXED) != 0)
+		_wake(obj, slot, INT_MAX);
+}
+
 }
 }
 
@@ -0,0 +1,184 @@
+#ifndef AVAKAR_ATOMIC_REF_ATOMIC_REF_INSTRUMENT_h
+#define AVAKAR_ATOMIC_REF_ATOMIC_REF_INSTRUMENT_h
+
+// Contention instrumentation, enabled by defining `AVAKAR_ATOMIC_REF_INSTRUMENT`
+// in all translation units. When disabled, `record` is an empty inline
+// function and the calls disappear entirely.
+//
+// When enabled, the public members of `atomic` and `atomic_ref` are never
+// inlined and note their return address, i.e. the caller's instruction
+// that follows the call, in a thread-local variable; `record` attributes
+// events to that site no matter how deep in the backend it is called.
+// Nested members, such as `operator++` calling `fetch_add`, keep the site
+// of the outermost one. Events recorded outside of a member fall back to
+// the return address of `record` itself.
+//
+// Each thread counts events per site in its own table; the tables are
+// never freed, so that the counts of finished threads remain available
+// to `avakar::atomic_ref_stats`.
+
+#include <cstddef>
+#include <cstdint>
+
+#ifdef AVAKAR_ATOMIC_REF_INSTRUMENT
+#include <atomic>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+namespace _avakar {
+namespace atomic_ref {
+
+enum class event
+{
+	cas_failure,
+	retry,
+	wait,
+	notify,
+};
+
+constexpr std::size_t event_count = 4;
+
+#ifndef AVAKAR_ATOMIC_REF_INSTRUMENT
+
+#define AVAKAR_ATOMIC_REF_ENTRY
+#define AVAKAR_ATOMIC_REF_SITE() (void)0
+
+inline void record(event e) noexcept
+{
+	(void)e;
+}
+
+#else
+
+#if defined(_MSC_VER)
+#define AVAKAR_ATOMIC_REF_ENTRY __declspec(noinline)
+#define AVAKAR_ATOMIC_REF_SITE() ::_avakar::atomic_ref::_site_scope _avakar_site(_ReturnAddress())
+#else
+#define AVAKAR_ATOMIC_REF_ENTRY __attribute__((noinline))
+#define AVAKAR_ATOMIC_REF_SITE() ::_avakar::atomic_ref::_site_scope _avakar_site(__builtin_return_address(0))
+#endif
+
+template <typename = void>
+struct _current_site
+{
+	static thread_local void const * site;
+};
+
+template <typename D>
+thread_local void const * _current_site<D>::site = nullptr;
+
+struct _site_scope
+{
+	explicit _site_scope(void const * site) noexcept
+		: _outermost(_current_site<>::site == nullptr)
+	{
+		if (_outermost)
+			_current_site<>::site = site;
+	}
+
+	_site_scope(_site_scope const &) = delete;
+	_site_scope & operator=(_site_scope const &) = delete;
+
+	~_site_scope()
+	{
+		if (_outermost)
+			_current_site<>::site = nullptr;
+	}
+
+private:
+	bool _outermost;
+};
+
+struct _site_counters
+{
+	std::atomic<void const *> site;
+	std::atomic<std::uint64_t> counts[event_count];
+};
+
+struct _site_table
+{
+	// The last entry collects the events of sites that don't fit.
+	static constexpr std::size_t capacity = 256;
+
+	_site_counters sites[capacity + 1];
+	_site_table * next;
+};
+
+template <typename = void>
+struct _site_registry
+{
+	static std::atomic<_site_table *> head;
+};
+
+template <typename D>
+std::atomic<_site_table *> _site_registry<D>::head;
+
+inline _site_table * _new_site_table()
+{
+	_site_table * table = new _site_table();
+
+	_site_table * head = _site_registry<>::head.load(std::memory_order_relaxed);
+	do
+		table->next = head;
+	while (!_site_registry<>::head.compare_exchange_weak(head, table, std::memory_order_release, std::memory_order_relaxed));
+
+	return table;
+}
+
+inline _site_counters & _counters_for(void const * site) noexcept
+{
+	static thread_local _site_table * table = _new_site_table();
+
+	std::size_t h = reinterpret_cast<std::uintptr_t>(site) * 0x9e3779b9u;
+	for (std::size_t i = 0; i != _site_table::capacity; ++i)
+	{
+		_site_counters & c = table->sites[(h + i) % _site_table::capacity];
+
+		void const * cur = c.site.load(std::memory_order_relaxed);
+		if (cur == site)
+			return c;
+
+		if (cur == nullptr)
+		{
+			c.site.store(site, std::memory_order_release);
+			return c;
+		}
+	}
+
+	return table->sites[_site_table::capacity];
+}
+
+#if defined(_MSC_VER)
+__declspec(noinline) inline void record(event e) noexcept
+{
+	void const * site = _current_site<>::site;
+	if (site == nullptr)
+		site = _ReturnAddress();
+#else
+__attribute__((noinline)) inline void record(event e) noexcept
+{
+	void const * site = _current_site<>::site;
+	if (site == nullptr)
+		site = __builtin_return_address(0);
+#endif
+
+	// Only the owning thread writes the counters, so there's no need for an RMW.
+	std::atomic<std::uint64_t> & count = _counters_for(site).counts[static_cast<std::size_t>(e)];
+	count.store(count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+
+#endif
+
+inline bool _record_cas(bool success) noexcept
+{
+	if (!success)
+		record(event::cas_failure);
+	return success;
+}
+
+}
+}
+
+#endif // _h
@@ -4,6 +4,7 @@
 #include "atomic_ref.msvc.x86_x64.h"
 
 #include <atomic>
+#include <cstddef>
 #include <type_traits>
 #include <intrin.h>
 
@@ -22,6 +23,21 @@ struct is_always_wait_free
 {
 };
 
+template <typename T>
+struct required_alignment
+	: std::integral_constant<std::size_t,
+		(is_always_lock_free<T>::value && (sizeof(T) & (sizeof(T) - 1)) == 0 && sizeof(T) > alignof(T)
+			? sizeof(T)
+			: alignof(T))>
+{
+};
+
+template <typename T>
+bool is_lock_free() noexcept
+{
+	return is_always_lock_free<T>::value;
+}
+
 template <typename T>
 auto load(T const & obj, std::memory_order order) noexcept
 	-> std::enable_if_t<sizeof(T) <= 8, T>
@@ -41,6 +57,37 @@ auto store(T & obj, T desired, std::memory_order order) noexcept
 	obj = desired;
 }
 
+template <typename T>
+auto load(T const & obj, std::integral_constant<std::memory_order, std::memory_order_relaxed>) noexcept
+	-> std::enable_if_t<sizeof(T) <= 8, T>
+{
+	return obj;
+}
+
+template <typename T, std::memory_order order>
+auto load(T const & obj, std::integral_constant<std::memory_order, order>) noexcept
+	-> std::enable_if_t<sizeof(T) <= 8 && order != std::memory_order_relaxed, T>
+{
+	T val = obj;
+	_ReadWriteBarrier();
+	return val;
+}
+
+template <typename T>
+auto store(T & obj, T desired, std::integral_constant<std::memory_order, std::memory_order_relaxed>) noexcept
+	-> std::enable_if_t<sizeof(T) <= 8>
+{
+	obj = desired;
+}
+
+template <typename T, std::memory_order order>
+auto store(T & obj, T desired, std::integral_constant<std::memory_order, order>) noexcept
+	-> std::enable_if_t<sizeof(T) <= 8 && order != std::memory_order_relaxed>
+{
+	_ReadWriteBarrier();
+	obj = desired;
+}
+
 template <typename T>
 auto exchange(T & obj, T desired, std::memory_order order) noexcept
 	-> std::enable_if_t<sizeof(T) == 8, T>
@@ -52,7 +99,7 @@ auto exchange(T & obj, T desired, std::memory_order order) noexcept
 
 template <typename T>
 auto fetch_add(T & obj, T arg, std::memory_order order) noexcept
-	-> std::enable_if_t<sizeof(T) == 8, T>
+	-> std::enable_if_t<sizeof(T) == 8 && !std::is_floating_point<T>::value, T>
 {
 	(void)order;
 	long long r = _InterlockedExchangeAdd64((long long *)&obj, (long long &)arg);
@@ -61,7 +108,7 @@ auto fetch_add(T & obj, T arg, std::memory_order order) noexcept
 
 template <typename T>
 auto fetch_sub(T & obj, T arg, std::memory_order order) noexcept
-	-> std::enable_if_t<sizeof(T) == 8, T>
+	-> std::enable_if_t<sizeof(T) == 8 && !std::is_floating_point<T>::value, T>
 {
 	(void)order;
 	long long r = _InterlockedExchangeAdd64((long long *)&obj, -(long long &)arg);
@@ -109,6 +156,30 @@ auto fetch_xor(T & obj, T arg, std::memory_order order) noexcept
 	return (T &)r;
 }
 
+template <typename T>
+auto bit_test_and_set(T & obj, unsigned int bit, std::memory_order order) noexcept
+	-> std::enable_if_t<sizeof(T) == 8, bool>
+{
+	(void)order;
+	return _interlockedbittestandset64((long long *)&obj, (long long)_bit_index<T>(bit)) != 0;
+}
+
+template <typename T>
+auto bit_test_and_reset(T & obj, unsigned int bit, std::memory_order order) noexcept
+	-> std::enable_if_t<sizeof(T) == 8, bool>
+{
+	(void)order;
+	return _interlockedbittestandreset64((long long *)&obj, (long long)_bit_index<T>(bit)) != 0;
+}
+
+template <typename T>
+auto bit_test_and_complement(T & obj, unsigned int bit, std::memory_order order) noexcept
+	-> std::enable_if_t<sizeof(T) == 8, bool>
+{
+	T mask = _bit_mask<T>(bit);
+	return (fetch_xor(obj, mask, order) & mask) != 0;
+}
+
 }
 }
 
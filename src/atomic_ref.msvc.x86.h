@@ -4,6 +4,7 @@
 #include "atomic_ref.msvc.x86_x64.h"
 
 #include <atomic>
+#include <cstddef>
 #include <type_traits>
 #include <intrin.h>
 
@@ -22,6 +23,21 @@ struct is_always_wait_free
 {
 };
 
+template <typename T>
+struct required_alignment
+	: std::integral_constant<std::size_t,
+		(is_always_lock_free<T>::value && (sizeof(T) & (sizeof(T) - 1)) == 0 && sizeof(T) > alignof(T)
+			? sizeof(T)
+			: alignof(T))>
+{
+};
+
+template <typename T>
+bool is_lock_free() noexcept
+{
+	return is_always_lock_free<T>::value;
+}
+
 template <typename T>
 auto load(T const & obj, std::memory_order order) noexcept
 	-> std::enable_if_t<sizeof(T) <= 4, T>
@@ -41,6 +57,37 @@ auto store(T & obj, T desired, std::memory_order order) noexcept
 	obj = desired;
 }
 
+template <typename T>
+auto load(T const & obj, std::integral_constant<std::memory_order, std::memory_order_relaxed>) noexcept
+	-> std::enable_if_t<sizeof(T) <= 4, T>
+{
+	return obj;
+}
+
+template <typename T, std::memory_order order>
+auto load(T const & obj, std::integral_constant<std::memory_order, order>) noexcept
+	-> std::enable_if_t<sizeof(T) <= 4 && order != std::memory_order_relaxed, T>
+{
+	T val = obj;
+	_ReadWriteBarrier();
+	return val;
+}
+
+template <typename T>
+auto store(T & obj, T desired, std::integral_constant<std::memory_order, std::memory_order_relaxed>) noexcept
+	-> std::enable_if_t<sizeof(T) <= 4>
+{
+	obj = desired;
+}
+
+template <typename T, std::memory_order order>
+auto store(T & obj, T desired, std::integral_constant<std::memory_order, order>) noexcept
+	-> std::enable_if_t<sizeof(T) <= 4 && order != std::memory_order_relaxed>
+{
+	_ReadWriteBarrier();
+	obj = desired;
+}
+
 template <typename T>
 auto load(T const & obj, std::memory_order order) noexcept
 	-> std::enable_if_t<sizeof(T) == 8, T>
@@ -69,18 +116,20 @@ auto exchange(T & obj, T desired, std::memory_order order) noexcept
 		long long prev = _InterlockedCompareExchange64((long long *)&obj, (long long &)desired, exp);
 		if (prev == exp)
 			return prev;
+		record(event::retry);
 		exp = prev;
 	}
 }
 
 template <typename T>
 auto fetch_add(T & obj, T arg, std::memory_order order) noexcept
-	-> std::enable_if_t<sizeof(T) == 8, T>
+	-> std::enable_if_t<sizeof(T) == 8 && !std::is_floating_point<T>::value, T>
 {
 	_ReadWriteBarrier();
 	T exp = obj;
 	while (!compare_exchange_weak(obj, exp, exp + arg, order, order))
 	{
+		record(event::retry);
 	}
 	_ReadWriteBarrier();
 	return exp;
@@ -88,12 +137,13 @@ auto fetch_add(T & obj, T arg, std::memory_order order) noexcept
 
 template <typename T>
 auto fetch_sub(T & obj, T arg, std::memory_order order) noexcept
-	-> std::enable_if_t<sizeof(T) == 8, T>
+	-> std::enable_if_t<sizeof(T) == 8 && !std::is_floating_point<T>::value, T>
 {
 	_ReadWriteBarrier();
 	T exp = obj;
 	while (!compare_exchange_weak(obj, exp, exp - arg, order, order))
 	{
+		record(event::retry);
 	}
 	_ReadWriteBarrier();
 	return exp;
@@ -121,6 +171,7 @@ auto fetch_and(T & obj, T arg, std::memory_order order) noexcept
 	T exp = obj;
 	while (!compare_exchange_weak(obj, exp, exp & arg, order, order))
 	{
+		record(event::retry);
 	}
 	_ReadWriteBarrier();
 	return exp;
@@ -134,6 +185,7 @@ auto fetch_or(T & obj, T arg, std::memory_order order) noexcept
 	T exp = obj;
 	while (!compare_exchange_weak(obj, exp, exp | arg, order, order))
 	{
+		record(event::retry);
 	}
 	_ReadWriteBarrier();
 	return exp;
@@ -147,11 +199,36 @@ auto fetch_xor(T & obj, T arg, std::memory_order order) noexcept
 	T exp = obj;
 	while (!compare_exchange_weak(obj, exp, exp ^ arg, order, order))
 	{
+		record(event::retry);
 	}
 	_ReadWriteBarrier();
 	return exp;
 }
 
+template <typename T>
+auto bit_test_and_set(T & obj, unsigned int bit, std::memory_order order) noexcept
+	-> std::enable_if_t<sizeof(T) == 8, bool>
+{
+	T mask = _bit_mask<T>(bit);
+	return (fetch_or(obj, mask, order) & mask) != 0;
+}
+
+template <typename T>
+auto bit_test_and_reset(T & obj, unsigned int bit, std::memory_order order) noexcept
+	-> std::enable_if_t<sizeof(T) == 8, bool>
+{
+	T mask = _bit_mask<T>(bit);
+	return (fetch_and(obj, T(~mask), order) & mask) != 0;
+}
+
+template <typename T>
+auto bit_test_and_complement(T & obj, unsigned int bit, std::memory_order order) noexcept
+	-> std::enable_if_t<sizeof(T) == 8, bool>
+{
+	T mask = _bit_mask<T>(bit);
+	return (fetch_xor(obj, mask, order) & mask) != 0;
+}
+
 }
 }
 
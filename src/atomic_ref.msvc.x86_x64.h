@@ -2,12 +2,50 @@
 #define AVAKAR_ATOMIC_REF_ATOMIC_REF_MSVC_X86_X64_h
 
 #include <atomic>
+#include <climits>
+#include <cstddef>
+#include <cstring>
+#include <functional>
 #include <type_traits>
 #include <intrin.h>
 
+#include "atomic_ref.instrument.h"
+
+#pragma comment(lib, "synchronization.lib")
+
+// Declared here rather than through <windows.h> to keep the macro soup
+// out of the users' translation units. The signatures match <synchapi.h>.
+extern "C" {
+__declspec(dllimport) int __stdcall WaitOnAddress(void volatile * Address, void * CompareAddress,
+#if defined(_M_IX86)
+	unsigned long AddressSize,
+#else
+	unsigned __int64 AddressSize,
+#endif
+	unsigned long dwMilliseconds);
+__declspec(dllimport) void __stdcall WakeByAddressSingle(void * Address);
+__declspec(dllimport) void __stdcall WakeByAddressAll(void * Address);
+__declspec(dllimport) unsigned long __stdcall GetCurrentProcessorNumber();
+}
+
 namespace _avakar {
 namespace atomic_ref {
 
+constexpr std::size_t cache_line_size = 64;
+
+inline void cpu_relax() noexcept
+{
+	_mm_pause();
+}
+
+// Returns the index of the CPU the calling thread is running on within
+// its processor group. The result is only a hint: the thread may migrate
+// at any time.
+inline std::size_t _cpu_hint() noexcept
+{
+	return GetCurrentProcessorNumber();
+}
+
 template <typename T>
 auto exchange(T & obj, T desired, std::memory_order order) noexcept
 	-> std::enable_if_t<sizeof(T) == 1, T>
@@ -105,6 +143,88 @@ bool compare_exchange_strong(T & obj, T & expected, T desired, std::memory_order
 	return compare_exchange_weak(obj, expected, desired, success, failure);
 }
 
+template <typename T>
+auto _volatile_load(T const & obj) noexcept
+	-> std::enable_if_t<sizeof(T) == 1, T>
+{
+	char r = __iso_volatile_load8((__int8 const volatile *)&obj);
+	_ReadWriteBarrier();
+	return (T &)r;
+}
+
+template <typename T>
+auto _volatile_load(T const & obj) noexcept
+	-> std::enable_if_t<sizeof(T) == 2, T>
+{
+	short r = __iso_volatile_load16((__int16 const volatile *)&obj);
+	_ReadWriteBarrier();
+	return (T &)r;
+}
+
+template <typename T>
+auto _volatile_load(T const & obj) noexcept
+	-> std::enable_if_t<sizeof(T) == 4, T>
+{
+	int r = __iso_volatile_load32((__int32 const volatile *)&obj);
+	_ReadWriteBarrier();
+	return (T &)r;
+}
+
+template <typename T>
+auto _volatile_load(T const & obj) noexcept
+	-> std::enable_if_t<sizeof(T) == 8, T>
+{
+	__int64 r = __iso_volatile_load64((__int64 const volatile *)&obj);
+	_ReadWriteBarrier();
+	return (T &)r;
+}
+
+template <typename T>
+auto fetch_add(T & obj, T arg, std::memory_order order) noexcept
+	-> std::enable_if_t<std::is_floating_point<T>::value, T>
+{
+	T cur = _volatile_load(obj);
+	while (!compare_exchange_weak(obj, cur, T(cur + arg), order, std::memory_order_relaxed))
+	{
+		record(event::retry);
+	}
+	return cur;
+}
+
+template <typename T>
+auto fetch_sub(T & obj, T arg, std::memory_order order) noexcept
+	-> std::enable_if_t<std::is_floating_point<T>::value, T>
+{
+	T cur = _volatile_load(obj);
+	while (!compare_exchange_weak(obj, cur, T(cur - arg), order, std::memory_order_relaxed))
+	{
+		record(event::retry);
+	}
+	return cur;
+}
+
+template <typename T>
+T fetch_max(T & obj, T arg, std::memory_order order) noexcept
+{
+	T cur = _volatile_load(obj);
+	while (std::less<T>()(cur, arg) && !compare_exchange_weak(obj, cur, arg, order, std::memory_order_relaxed))
+	{
+		record(event::retry);
+	}
+	return cur;
+}
+
+template <typename T>
+T fetch_min(T & obj, T arg, std::memory_order order) noexcept
+{
+	T cur = _volatile_load(obj);
+	while (std::less<T>()(arg, cur) && !compare_exchange_weak(obj, cur, arg, order, std::memory_order_relaxed))
+	{
+		record(event::retry);
+	}
+	return cur;
+}
+
 template <typename T>
 auto fetch_add(T & obj, T arg, std::memory_order order) noexcept
 	-> std::enable_if_t<sizeof(T) == 1, T>
@@ -125,7 +245,7 @@ auto fetch_add(T & obj, T arg, std::memory_order order) noexcept
 
 template <typename T>
 auto fetch_add(T & obj, T arg, std::memory_order order) noexcept
-	-> std::enable_if_t<sizeof(T) == 4, T>
+	-> std::enable_if_t<sizeof(T) == 4 && !std::is_floating_point<T>::value, T>
 {
 	(void)order;
 	long r = _InterlockedExchangeAdd((long *)&obj, (long &)arg);
@@ -152,7 +272,7 @@ auto fetch_sub(T & obj, T arg, std::memory_order order) noexcept
 
 template <typename T>
 auto fetch_sub(T & obj, T arg, std::memory_order order) noexcept
-	-> std::enable_if_t<sizeof(T) == 4, T>
+	-> std::enable_if_t<sizeof(T) == 4 && !std::is_floating_point<T>::value, T>
 {
 	(void)order;
 	long r = _InterlockedExchangeAdd((long *)&obj, -(long &)arg);
@@ -240,6 +360,91 @@ auto fetch_xor(T & obj, T arg, std::memory_order order) noexcept
 	return (T &)r;
 }
 
+// As with the immediate form of `bt*`, the bit index is taken modulo
+// the width of T; the register form with a memory operand would reach
+// past the object.
+template <typename T>
+unsigned int _bit_index(unsigned int bit) noexcept
+{
+	return bit & (sizeof(T) * CHAR_BIT - 1);
+}
+
+template <typename T>
+T _bit_mask(unsigned int bit) noexcept
+{
+	return static_cast<T>(std::make_unsigned_t<T>(1) << _bit_index<T>(bit));
+}
+
+template <typename T>
+auto bit_test_and_set(T & obj, unsigned int bit, std::memory_order order) noexcept
+	-> std::enable_if_t<sizeof(T) == 1 || sizeof(T) == 2, bool>
+{
+	T mask = _bit_mask<T>(bit);
+	return (fetch_or(obj, mask, order) & mask) != 0;
+}
+
+template <typename T>
+auto bit_test_and_set(T & obj, unsigned int bit, std::memory_order order) noexcept
+	-> std::enable_if_t<sizeof(T) == 4, bool>
+{
+	(void)order;
+	return _interlockedbittestandset((long *)&obj, (long)_bit_index<T>(bit)) != 0;
+}
+
+template <typename T>
+auto bit_test_and_reset(T & obj, unsigned int bit, std::memory_order order) noexcept
+	-> std::enable_if_t<sizeof(T) == 1 || sizeof(T) == 2, bool>
+{
+	T mask = _bit_mask<T>(bit);
+	return (fetch_and(obj, T(~mask), order) & mask) != 0;
+}
+
+template <typename T>
+auto bit_test_and_reset(T & obj, unsigned int bit, std::memory_order order) noexcept
+	-> std::enable_if_t<sizeof(T) == 4, bool>
+{
+	(void)order;
+	return _interlockedbittestandreset((long *)&obj, (long)_bit_index<T>(bit)) != 0;
+}
+
+template <typename T>
+auto bit_test_and_complement(T & obj, unsigned int bit, std::memory_order order) noexcept
+	-> std::enable_if_t<sizeof(T) <= 4, bool>
+{
+	T mask = _bit_mask<T>(bit);
+	return (fetch_xor(obj, mask, order) & mask) != 0;
+}
+
+template <typename T>
+void wait(T const & obj, T old, std::memory_order order) noexcept
+{
+	(void)order;
+
+	for (;;)
+	{
+		T cur = _volatile_load(obj);
+		if (std::memcmp(&cur, &old, sizeof(T)) != 0)
+			return;
+
+		record(event::wait);
+		WaitOnAddress((T volatile *)&obj, &old, sizeof(T), 0xffffffff);
+	}
+}
+
+template <typename T>
+void notify_one(T const & obj) noexcept
+{
+	record(event::notify);
+	WakeByAddressSingle((void *)&obj);
+}
+
+template <typename T>
+void notify_all(T const & obj) noexcept
+{
+	record(event::notify);
+	WakeByAddressAll((void *)&obj);
+}
+
 }
 }
 
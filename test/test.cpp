@@ -1,6 +1,38 @@
 #include <avakar/atomic_ref.h>
+#include <avakar/atomic.h>
+#include <avakar/atomic_ref_stats.h>
+#include <avakar/atomic_tagged_ptr.h>
+#include <avakar/barrier.h>
+#include <avakar/epoch.h>
+#include <avakar/eventcount.h>
+#include <avakar/fetch_update.h>
+#include <avakar/flat_combining.h>
+#include <avakar/hazard_pointer.h>
+#include <avakar/latch.h>
+#include <avakar/mcs_lock.h>
+#include <avakar/mpmc_queue.h>
+#include <avakar/mutex.h>
+#include <avakar/object_pool.h>
+#include <avakar/padded_atomic.h>
+#include <avakar/semaphore.h>
+#include <avakar/shared_mutex.h>
+#include <avakar/spsc_queue.h>
+#include <avakar/striped_counter.h>
+#include <avakar/ticket_lock.h>
+#include <avakar/treiber_stack.h>
 #include <catch2/catch.hpp>
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
 using avakar::atomic_ref;
+using avakar::atomic;
 
 TEST_CASE("Pointer add/sub is correct")
 {
@@ -38,3 +70,1500 @@ TEST_CASE("Pointer arithmetic is correct")
 	REQUIRE(a.fetch_sub(2) == &arr[2]);
 	REQUIRE(p == &arr[0]);
 }
+
+TEST_CASE("wait returns immediately if the value differs")
+{
+	int v = 1;
+	atomic_ref<int> a(v);
+	a.wait(0);
+
+	atomic<std::uint64_t> b(1);
+	b.wait(0);
+}
+
+TEST_CASE("wait blocks until notified")
+{
+	int v = 0;
+	atomic_ref<int> a(v);
+
+	atomic<std::uint64_t> b(0);
+
+	std::thread t([&] {
+		a.wait(0);
+		b.store(1);
+		b.notify_one();
+	});
+
+	a.store(1);
+	a.notify_one();
+	b.wait(0);
+	REQUIRE(b.load() == 1);
+
+	t.join();
+}
+
+namespace {
+
+struct big_t
+{
+	std::uint64_t a, b, c, d;
+};
+
+template <typename T, typename = void>
+struct has_difference_type
+	: std::false_type
+{
+};
+
+template <typename T>
+struct has_difference_type<T, decltype(void(std::declval<typename T::difference_type>()))>
+	: std::true_type
+{
+};
+
+static_assert(!has_difference_type<atomic_ref<big_t>>::value, "");
+static_assert(!has_difference_type<atomic<big_t>>::value, "");
+static_assert(std::is_same<atomic_ref<int>::difference_type, int>::value, "");
+static_assert(std::is_same<atomic<int *>::difference_type, std::ptrdiff_t>::value, "");
+static_assert(std::is_same<atomic_ref<double>::difference_type, double>::value, "");
+
+}
+
+TEST_CASE("Large objects are supported")
+{
+	static_assert(!atomic_ref<big_t>::is_always_lock_free, "");
+
+	big_t v = { 1, 2, 3, 4 };
+	atomic_ref<big_t> a(v);
+
+	big_t r = a.load();
+	REQUIRE(r.a == 1);
+	REQUIRE(r.d == 4);
+
+	a.store({ 5, 6, 7, 8 });
+	REQUIRE(v.a == 5);
+
+	r = a.exchange({ 1, 1, 1, 1 });
+	REQUIRE(r.b == 6);
+
+	big_t exp = { 2, 2, 2, 2 };
+	REQUIRE(!a.compare_exchange_strong(exp, { 3, 3, 3, 3 }));
+	REQUIRE(exp.c == 1);
+	REQUIRE(a.compare_exchange_strong(exp, { 3, 3, 3, 3 }));
+	REQUIRE(v.d == 3);
+}
+
+TEST_CASE("Large objects are updated atomically")
+{
+	big_t v = {};
+	atomic_ref<big_t> a(v);
+
+	auto worker = [&] {
+		for (int i = 0; i != 10000; ++i)
+		{
+			big_t exp = a.load();
+			while (!a.compare_exchange_weak(exp, { exp.a + 1, exp.b + 1, exp.c + 1, exp.d + 1 }))
+			{
+			}
+		}
+	};
+
+	std::thread t1(worker);
+	std::thread t2(worker);
+	t1.join();
+	t2.join();
+
+	REQUIRE(v.a == 20000);
+	REQUIRE(v.d == 20000);
+}
+
+TEST_CASE("Loads of large objects are never torn")
+{
+	big_t v = {};
+	atomic_ref<big_t> a(v);
+
+	atomic<bool> done(false);
+	std::thread writer([&] {
+		for (std::uint64_t i = 1; i != 20000; ++i)
+			a.store({ i, i, i, i });
+		done.store(true);
+	});
+
+	bool torn = false;
+	while (!done.load())
+	{
+		big_t r = a.load();
+		torn = torn || r.a != r.b || r.a != r.c || r.a != r.d;
+	}
+
+	writer.join();
+	REQUIRE(!torn);
+}
+
+namespace {
+
+struct tagged_t
+{
+	void * ptr;
+	std::uint64_t tag;
+};
+
+}
+
+TEST_CASE("16-byte objects are supported")
+{
+	static_assert(atomic<tagged_t>::required_alignment == 16 || sizeof(void *) != 8, "");
+
+	atomic<tagged_t> a(tagged_t{ nullptr, 1 });
+	REQUIRE(reinterpret_cast<std::uintptr_t>(&a) % atomic<tagged_t>::required_alignment == 0);
+
+	tagged_t r = a.load();
+	REQUIRE(r.ptr == nullptr);
+	REQUIRE(r.tag == 1);
+
+	int x;
+	a.store({ &x, 2 });
+	r = a.exchange({ nullptr, 3 });
+	REQUIRE(r.ptr == &x);
+	REQUIRE(r.tag == 2);
+
+	tagged_t exp = { nullptr, 2 };
+	REQUIRE(!a.compare_exchange_strong(exp, { &x, 4 }));
+	REQUIRE(exp.tag == 3);
+	REQUIRE(a.compare_exchange_strong(exp, { &x, 4 }));
+	REQUIRE(a.load().tag == 4);
+}
+
+TEST_CASE("16-byte objects are updated atomically")
+{
+	atomic<tagged_t> a(tagged_t{ nullptr, 0 });
+
+	auto worker = [&] {
+		for (int i = 0; i != 10000; ++i)
+		{
+			tagged_t exp = a.load();
+			while (!a.compare_exchange_weak(exp, { &a, exp.tag + 1 }))
+			{
+			}
+		}
+	};
+
+	std::thread t1(worker);
+	std::thread t2(worker);
+	t1.join();
+	t2.join();
+
+	REQUIRE(a.load().tag == 20000);
+}
+
+TEST_CASE("8-aligned 16-byte objects are supported")
+{
+	struct alignas(16)
+	{
+		std::uint64_t pad;
+		tagged_t obj[2];
+	} s = {};
+
+	// Both lie at odd multiples of 8.
+	for (tagged_t & obj: s.obj)
+	{
+		atomic_ref<tagged_t> a(obj);
+		a.store({ &s, 1 });
+		REQUIRE(a.load().tag == 1);
+
+		tagged_t exp = { &s, 1 };
+		REQUIRE(a.compare_exchange_strong(exp, { nullptr, 2 }));
+		REQUIRE(a.exchange({ &s, 3 }).tag == 2);
+		REQUIRE(obj.ptr == &s);
+		REQUIRE(obj.tag == 3);
+	}
+}
+
+TEST_CASE("Floating-point add/sub is correct")
+{
+	double v = 1.5;
+	atomic_ref<double> a(v);
+
+	REQUIRE(a.fetch_add(2) == 1.5);
+	REQUIRE(v == 3.5);
+	REQUIRE(a.fetch_sub(0.5) == 3.5);
+	REQUIRE(v == 3);
+
+	a += 1;
+	REQUIRE(a.load() == 4);
+
+	atomic<float> b(1.f);
+	REQUIRE(b.fetch_add(1.f) == 1.f);
+	REQUIRE(b.load() == 2.f);
+
+	long double l = 1;
+	atomic_ref<long double> c(l);
+	REQUIRE(c.fetch_add(1) == 1);
+	REQUIRE(l == 2);
+}
+
+TEST_CASE("Floating-point add is atomic")
+{
+	atomic<double> a(0);
+
+	auto worker = [&] {
+		for (int i = 0; i != 10000; ++i)
+			a.fetch_add(1, std::memory_order_relaxed);
+	};
+
+	std::thread t1(worker);
+	std::thread t2(worker);
+	t1.join();
+	t2.join();
+
+	REQUIRE(a.load() == 20000);
+}
+
+TEST_CASE("fetch_max/fetch_min are correct")
+{
+	int v = 5;
+	atomic_ref<int> a(v);
+
+	REQUIRE(a.fetch_max(3) == 5);
+	REQUIRE(v == 5);
+	REQUIRE(a.fetch_max(7) == 5);
+	REQUIRE(v == 7);
+	REQUIRE(a.fetch_min(9) == 7);
+	REQUIRE(v == 7);
+	REQUIRE(a.fetch_min(-1) == 7);
+	REQUIRE(v == -1);
+
+	int arr[] = { 1, 2, 3 };
+	atomic<int *> p(&arr[1]);
+	REQUIRE(p.fetch_max(&arr[0]) == &arr[1]);
+	REQUIRE(p.fetch_max(&arr[2]) == &arr[1]);
+	REQUIRE(p.fetch_min(&arr[0]) == &arr[2]);
+	REQUIRE(p.load() == &arr[0]);
+
+	atomic<double> d(1.5);
+	REQUIRE(d.fetch_max(2.5) == 1.5);
+	REQUIRE(d.fetch_min(0.5) == 2.5);
+	REQUIRE(d.load() == 0.5);
+}
+
+TEST_CASE("Bit operations are correct")
+{
+	std::uint32_t v = 0;
+	atomic_ref<std::uint32_t> a(v);
+
+	REQUIRE(!a.bit_test_and_set(31));
+	REQUIRE(v == 0x80000000);
+	REQUIRE(a.bit_test_and_set(31));
+	REQUIRE(!a.bit_test_and_complement(3));
+	REQUIRE(v == 0x80000008);
+	REQUIRE(a.bit_test_and_complement(3));
+	REQUIRE(a.bit_test_and_reset(31));
+	REQUIRE(!a.bit_test_and_reset(31));
+	REQUIRE(v == 0);
+
+	atomic<std::uint8_t> b(0);
+	REQUIRE(!b.bit_test_and_set(7));
+	REQUIRE(b.load() == 0x80);
+
+	atomic<std::int64_t> c(0);
+	REQUIRE(!c.bit_test_and_set(63));
+	REQUIRE(c.bit_test_and_reset(63));
+	REQUIRE(c.load() == 0);
+
+	atomic<std::int16_t> d(0);
+	REQUIRE(!d.bit_test_and_complement(15));
+	REQUIRE(d.load() == INT16_MIN);
+}
+
+TEST_CASE("Bit indices wrap around the width of the object")
+{
+	std::uint32_t v[3] = {};
+	atomic_ref<std::uint32_t> a(v[1]);
+
+	REQUIRE(!a.bit_test_and_set(33));
+	REQUIRE(v[1] == 2);
+	REQUIRE(!a.bit_test_and_complement(64 + 4));
+	REQUIRE(v[1] == 0x12);
+	REQUIRE(a.bit_test_and_reset(unsigned(-31)));
+	REQUIRE(v[1] == 0x10);
+	REQUIRE(v[0] == 0);
+	REQUIRE(v[2] == 0);
+
+	atomic<std::uint64_t> b(0);
+	REQUIRE(!b.bit_test_and_set(64 + 63));
+	REQUIRE(b.load() == std::uint64_t(1) << 63);
+
+	atomic<std::uint8_t> c(0);
+	REQUIRE(!c.bit_test_and_set(9));
+	REQUIRE(c.load() == 2);
+}
+
+TEST_CASE("Memory orders can be passed as types")
+{
+	int v = 0;
+	atomic_ref<int> a(v);
+
+	a.store(1, avakar::memory_order_relaxed_t());
+	a.store<std::memory_order_release>(2);
+	REQUIRE(a.load<std::memory_order_acquire>() == 2);
+	REQUIRE(a.load(avakar::memory_order_relaxed_t()) == 2);
+	REQUIRE(a.fetch_add<std::memory_order_acq_rel>(1) == 2);
+	REQUIRE(a.exchange(5, avakar::memory_order_seq_cst_t()) == 3);
+
+	int exp = 4;
+	REQUIRE(!a.compare_exchange_strong<std::memory_order_acq_rel>(exp, 6));
+	REQUIRE(exp == 5);
+	REQUIRE(a.compare_exchange_strong<std::memory_order_release, std::memory_order_relaxed>(exp, 6));
+	while (!a.compare_exchange_weak(exp, 7, avakar::memory_order_acquire_t(), avakar::memory_order_relaxed_t()))
+	{
+	}
+	REQUIRE(v == 7);
+
+	atomic<double> d(1);
+	REQUIRE(d.fetch_add<std::memory_order_relaxed>(1) == 1);
+	REQUIRE(d.load<std::memory_order_relaxed>() == 2);
+
+	big_t b = {};
+	avakar::safe_atomic_ref<big_t> ab(b);
+	ab.store<std::memory_order_release>({ 1, 2, 3, 4 });
+	REQUIRE(ab.load<std::memory_order_acquire>().d == 4);
+}
+
+TEST_CASE("Contention statistics are collected per site")
+{
+	avakar::reset_atomic_ref_stats();
+
+	int v = 1;
+	atomic_ref<int> a(v);
+
+	int exp = 0;
+	REQUIRE(!a.compare_exchange_strong(exp, 2));
+	REQUIRE(!a.compare_exchange_strong(exp = 0, 2));
+
+	// A single site, however many times it's executed.
+	for (int i = 0; i != 3; ++i)
+		REQUIRE(!a.compare_exchange_weak(exp = 0, 2));
+
+	a.notify_one();
+
+	auto stats = avakar::atomic_ref_stats();
+#ifdef AVAKAR_ATOMIC_REF_INSTRUMENT
+	std::uint64_t cas_failures = 0;
+	std::uint64_t notifies = 0;
+	std::size_t sites = 0;
+	for (auto const & s: stats)
+	{
+		cas_failures += s.cas_failures;
+		notifies += s.notifies;
+		if (s.cas_failures != 0)
+			++sites;
+	}
+	REQUIRE(cas_failures == 5);
+	REQUIRE(sites == 3);
+
+	// Notifications count whether or not there are waiters.
+	REQUIRE(notifies == 1);
+
+	avakar::reset_atomic_ref_stats();
+	REQUIRE(avakar::atomic_ref_stats().empty());
+#else
+	REQUIRE(stats.empty());
+#endif
+}
+
+TEST_CASE("striped_counter sums increments from all threads")
+{
+	avakar::striped_counter<std::uint64_t> c(5);
+	REQUIRE(c.load() == 5);
+
+	std::thread threads[4];
+	for (std::thread & t: threads)
+	{
+		t = std::thread([&] {
+			for (int i = 0; i != 10000; ++i)
+				++c;
+			c -= 1000;
+		});
+	}
+
+	for (std::thread & t: threads)
+		t.join();
+
+	REQUIRE(c == 4 * 9000 + 5);
+	REQUIRE(c.reset() == 4 * 9000 + 5);
+	REQUIRE(c.load() == 0);
+
+	avakar::striped_counter<int, 4> s;
+	s -= 3;
+	REQUIRE(s.load() == -3);
+}
+
+TEST_CASE("padded_atomic elements are on separate cache lines")
+{
+	constexpr std::size_t line = avakar::hardware_destructive_interference_size;
+	static_assert(sizeof(avakar::padded_atomic<std::uint8_t>) == line, "");
+	static_assert(alignof(avakar::padded_atomic<std::uint64_t>) == line, "");
+
+	avakar::padded_atomic<int> a(1);
+	a = 2;
+	REQUIRE(++a == 3);
+
+	avakar::padded_atomic_array<std::uint32_t, 4> arr(7);
+	REQUIRE(arr.size() == 4);
+	REQUIRE((char *)&arr[1] - (char *)&arr[0] == (std::ptrdiff_t)line);
+
+	arr[2].fetch_add(1);
+	std::uint32_t sum = 0;
+	for (auto const & elem: arr)
+		sum += elem.load();
+	REQUIRE(sum == 29);
+}
+
+TEST_CASE("atomic_tagged_ptr bumps the tag on every successful CAS")
+{
+	int arr[4] = {};
+	avakar::atomic_tagged_ptr<int> a(&arr[0]);
+
+	auto cur = a.load();
+	REQUIRE(cur.ptr() == &arr[0]);
+	REQUIRE(cur.tag() == 0);
+
+	auto stale = cur;
+	REQUIRE(a.compare_exchange_strong(cur, &arr[1]));
+	REQUIRE(a.load().tag() == 1);
+
+	cur = a.load();
+	REQUIRE(a.compare_exchange_strong(cur, &arr[0]));
+
+	// The pointer is back, but the tag tells the CAS it's been replaced.
+	REQUIRE(!a.compare_exchange_strong(stale, &arr[2]));
+	REQUIRE(stale.ptr() == &arr[0]);
+	REQUIRE(stale.tag() == 2);
+
+	REQUIRE(a.fetch_add(3).ptr() == &arr[0]);
+	REQUIRE(a.load().ptr() == &arr[3]);
+	REQUIRE(a.load().tag() == 2);
+	REQUIRE(a.fetch_sub(1).tag() == 2);
+	REQUIRE(a.load().ptr() == &arr[2]);
+
+	// Tags wrap around instead of corrupting the pointer.
+	avakar::tagged_ptr<int> last(&arr[1], avakar::tagged_ptr<int>::tag_mask >> avakar::tagged_ptr<int>::tag_shift);
+	REQUIRE(last.ptr() == &arr[1]);
+	REQUIRE(last.next(&arr[1]).tag() == 0);
+	REQUIRE(last.next(&arr[1]).ptr() == &arr[1]);
+}
+
+namespace {
+
+struct hp_node
+	: avakar::hazard_pointer_obj_base<hp_node>
+{
+	explicit hp_node(int & live)
+		: live(live)
+	{
+		++live;
+	}
+
+	~hp_node()
+	{
+		--live;
+	}
+
+	int & live;
+};
+
+}
+
+TEST_CASE("Hazard pointers defer reclamation of protected objects")
+{
+	int live = 0;
+	avakar::hazard_domain domain;
+
+	hp_node * head = new hp_node(live);
+	atomic_ref<hp_node *> ref(head);
+
+	avakar::hazard_pointer hp = avakar::make_hazard_pointer(domain);
+	REQUIRE(!hp.empty());
+	hp_node * n = hp.protect(ref);
+	REQUIRE(n == head);
+
+	ref.store(new hp_node(live));
+	n->retire(domain);
+	domain.cleanup();
+	REQUIRE(live == 2);
+
+	hp.reset_protection();
+	domain.cleanup();
+	REQUIRE(live == 1);
+
+	hp_node * cur = ref.load();
+	REQUIRE(hp.try_protect(cur, ref));
+	REQUIRE(cur == head);
+	hp = avakar::hazard_pointer();
+	ref.load()->retire(domain);
+
+	domain.cleanup();
+	REQUIRE(live == 0);
+}
+
+TEST_CASE("Hazard pointers protect concurrent readers")
+{
+	std::atomic<int> live{ 0 };
+
+	struct node
+		: avakar::hazard_pointer_obj_base<node>
+	{
+		explicit node(std::atomic<int> & live, int value)
+			: live(live), value(value)
+		{
+			++live;
+		}
+
+		~node()
+		{
+			value = -1;
+			--live;
+		}
+
+		std::atomic<int> & live;
+		int value;
+	};
+
+	{
+		avakar::hazard_domain domain;
+		atomic<node *> shared(new node(live, 0));
+		std::atomic<bool> done{ false };
+		bool saw_reclaimed = false;
+
+		std::thread reader([&] {
+			avakar::hazard_pointer hp = avakar::make_hazard_pointer(domain);
+			while (!done.load())
+			{
+				node * n = hp.protect(shared);
+				if (n->value < 0)
+					saw_reclaimed = true;
+				hp.reset_protection();
+			}
+		});
+
+		for (int i = 1; i != 2000; ++i)
+			shared.exchange(new node(live, i))->retire(domain);
+
+		done.store(true);
+		reader.join();
+		shared.load()->retire(domain);
+		REQUIRE(!saw_reclaimed);
+	}
+
+	REQUIRE(live.load() == 0);
+}
+
+namespace {
+
+struct epoch_obj
+{
+	explicit epoch_obj(std::atomic<int> & live)
+		: live(live)
+	{
+		++live;
+	}
+
+	~epoch_obj()
+	{
+		--live;
+	}
+
+	std::atomic<int> & live;
+};
+
+}
+
+TEST_CASE("Epochs defer reclamation past critical sections")
+{
+	std::atomic<int> live{ 0 };
+
+	{
+		avakar::epoch_domain domain;
+		avakar::epoch_participant reader(domain);
+		avakar::epoch_participant writer(domain);
+
+		epoch_obj * obj = new epoch_obj(live);
+		atomic_ref<epoch_obj *> ref(obj);
+
+		{
+			avakar::epoch_guard guard(reader);
+			epoch_obj * seen = ref.load();
+
+			writer.retire(ref.exchange(nullptr));
+			for (int i = 0; i != 4; ++i)
+				writer.try_reclaim();
+
+			// The reader is pinned in the retirement epoch, so the epoch
+			// could advance at most once.
+			REQUIRE(domain.epoch() <= 1);
+			REQUIRE(live == 1);
+			REQUIRE(&seen->live == &live);
+		}
+
+		for (int i = 0; i != 4; ++i)
+			writer.try_reclaim();
+		REQUIRE(live == 0);
+
+		// Objects of departed participants are reclaimed by the domain.
+		{
+			avakar::epoch_participant temp(domain);
+			temp.retire(new epoch_obj(live));
+		}
+		REQUIRE(live == 1);
+	}
+
+	REQUIRE(live == 0);
+}
+
+TEST_CASE("Epochs protect concurrent readers")
+{
+	std::atomic<int> live{ 0 };
+
+	struct node
+	{
+		explicit node(std::atomic<int> & live, int value)
+			: live(live), value(value)
+		{
+			++live;
+		}
+
+		~node()
+		{
+			value = -1;
+			--live;
+		}
+
+		std::atomic<int> & live;
+		int value;
+	};
+
+	{
+		avakar::epoch_domain domain;
+		atomic<node *> shared(new node(live, 0));
+		std::atomic<bool> done{ false };
+		bool saw_reclaimed = false;
+
+		std::thread reader([&] {
+			avakar::epoch_participant self(domain);
+			while (!done.load())
+			{
+				avakar::epoch_guard guard(self);
+				if (shared.load()->value < 0)
+					saw_reclaimed = true;
+			}
+		});
+
+		{
+			avakar::epoch_participant self(domain);
+			for (int i = 1; i != 2000; ++i)
+				self.retire(shared.exchange(new node(live, i)));
+
+			done.store(true);
+			reader.join();
+			self.retire(shared.load());
+		}
+
+		REQUIRE(!saw_reclaimed);
+	}
+
+	REQUIRE(live.load() == 0);
+}
+
+TEST_CASE("spsc_queue pushes and pops in order across the wrap-around")
+{
+	avakar::spsc_queue<std::string> q(3);
+	REQUIRE(q.capacity() == 4);
+	REQUIRE(q.empty());
+
+	REQUIRE(q.try_push("a"));
+	REQUIRE(q.try_emplace(2, 'b'));
+
+	std::string s;
+	REQUIRE(q.try_pop(s));
+	REQUIRE(s == "a");
+
+	std::string in[] = { "c", "d", "e", "f" };
+	REQUIRE(q.push_n(in, 4) == 3);
+	REQUIRE(!q.try_push("g"));
+	REQUIRE(q.size() == 4);
+
+	std::string out[5];
+	REQUIRE(q.pop_n(out, 5) == 4);
+	REQUIRE(out[0] == "bb");
+	REQUIRE(out[3] == "e");
+	REQUIRE(!q.try_pop(s));
+
+	REQUIRE(q.try_push("h"));
+}
+
+namespace {
+
+struct counted
+{
+	static int live;
+
+	explicit counted()
+		: throws(false)
+	{
+		++live;
+	}
+
+	counted(counted const & o)
+		: throws(o.throws)
+	{
+		if (throws)
+			throw std::runtime_error("copy");
+		++live;
+	}
+
+	~counted()
+	{
+		--live;
+	}
+
+	bool throws;
+};
+
+int counted::live = 0;
+
+}
+
+TEST_CASE("spsc_queue::push_n leaves the queue unchanged if a copy throws")
+{
+	{
+		avakar::spsc_queue<counted> q(4);
+
+		// Move the indices to the middle, so that the copy wraps around.
+		counted c, out[2];
+		REQUIRE(q.try_push(c));
+		REQUIRE(q.try_push(c));
+		REQUIRE(q.pop_n(out, 2) == 2);
+
+		counted in[4];
+		in[3].throws = true;
+		int live = counted::live;
+		REQUIRE_THROWS_AS(q.push_n(in, 4), std::runtime_error);
+		REQUIRE(counted::live == live);
+		REQUIRE(q.empty());
+	}
+
+	REQUIRE(counted::live == 0);
+}
+
+TEST_CASE("spsc_queue transfers elements between threads")
+{
+	avakar::spsc_queue<std::uint32_t> q(64);
+
+	std::thread producer([&] {
+		std::uint32_t batch[7];
+		std::uint32_t next = 0;
+		while (next != 100000)
+		{
+			std::uint32_t n = std::min<std::uint32_t>(7, 100000 - next);
+			for (std::uint32_t i = 0; i != n; ++i)
+				batch[i] = next + i;
+
+			std::uint32_t pushed = 0;
+			while (pushed != n)
+			{
+				std::uint32_t r = (std::uint32_t)q.push_n(batch + pushed, n - pushed);
+				if (r == 0)
+					std::this_thread::yield();
+				pushed += r;
+			}
+			next += n;
+		}
+	});
+
+	std::uint32_t expected = 0;
+	bool in_order = true;
+	while (expected != 100000)
+	{
+		std::uint32_t batch[5];
+		std::size_t n = q.pop_n(batch, 5);
+		if (n == 0)
+			std::this_thread::yield();
+		for (std::size_t i = 0; i != n; ++i)
+			in_order = in_order && batch[i] == expected++;
+	}
+
+	producer.join();
+	REQUIRE(in_order);
+	REQUIRE(q.empty());
+}
+
+TEST_CASE("mpmc_queue try operations respect the capacity")
+{
+	avakar::mpmc_queue<std::string> q(2);
+	REQUIRE(q.capacity() == 2);
+
+	std::string s;
+	REQUIRE(!q.try_pop(s));
+	REQUIRE(q.try_push("a"));
+	REQUIRE(q.try_emplace(2, 'b'));
+	REQUIRE(!q.try_push("c"));
+
+	REQUIRE(q.try_pop(s));
+	REQUIRE(s == "a");
+	q.push("d");
+
+	q.pop(s);
+	REQUIRE(s == "bb");
+	REQUIRE(q.try_pop(s));
+	REQUIRE(s == "d");
+	REQUIRE(!q.try_pop(s));
+
+	q.push("left in the queue");
+}
+
+namespace {
+
+struct fragile
+{
+	explicit fragile(int v = 0)
+		: v(v)
+	{
+		if (v < 0)
+			throw std::runtime_error("construct");
+	}
+
+	fragile(fragile && o) noexcept
+		: v(o.v)
+	{
+	}
+
+	fragile & operator=(fragile && o)
+	{
+		if (o.v == 13)
+			throw std::runtime_error("assign");
+		v = o.v;
+		return *this;
+	}
+
+	int v;
+};
+
+}
+
+TEST_CASE("Non-blocking mpmc_queue hands elements over")
+{
+	avakar::mpmc_queue<std::uint32_t, false> q(4);
+	std::uint32_t v;
+
+	for (std::uint32_t lap = 0; lap != 3; ++lap)
+	{
+		for (std::uint32_t i = 0; i != 4; ++i)
+			REQUIRE(q.try_push(lap * 4 + i));
+		REQUIRE(!q.try_push(0));
+
+		for (std::uint32_t i = 0; i != 4; ++i)
+		{
+			REQUIRE(q.try_pop(v));
+			REQUIRE(v == lap * 4 + i);
+		}
+		REQUIRE(!q.try_pop(v));
+	}
+}
+
+TEST_CASE("mpmc_queue survives throwing constructors and assignments")
+{
+	avakar::mpmc_queue<fragile> q(2);
+
+	REQUIRE_THROWS_AS(q.try_emplace(-1), std::runtime_error);
+	REQUIRE_THROWS_AS(q.emplace(-1), std::runtime_error);
+
+	REQUIRE(q.try_emplace(13));
+	fragile f;
+	REQUIRE_THROWS_AS(q.try_pop(f), std::runtime_error);
+	q.emplace(13);
+	REQUIRE_THROWS_AS(q.pop(f), std::runtime_error);
+
+	// Go around a few laps to make sure that no slot is stuck.
+	for (int i = 1; i != 10; ++i)
+	{
+		REQUIRE(q.try_emplace(i));
+		q.emplace(i + 100);
+		REQUIRE(!q.try_emplace(0));
+
+		REQUIRE(q.try_pop(f));
+		REQUIRE(f.v == i);
+		q.pop(f);
+		REQUIRE(f.v == i + 100);
+		REQUIRE(!q.try_pop(f));
+	}
+}
+
+TEST_CASE("mpmc_queue hands every element to exactly one consumer")
+{
+	constexpr int producers = 3;
+	constexpr int consumers = 3;
+	constexpr std::uint32_t per_producer = 20000;
+
+	avakar::mpmc_queue<std::uint32_t> q(16);
+	std::atomic<std::uint64_t> sum{ 0 };
+	std::atomic<std::uint32_t> count{ 0 };
+
+	std::thread threads[producers + consumers];
+	for (int i = 0; i != producers; ++i)
+	{
+		threads[i] = std::thread([&q, i] {
+			for (std::uint32_t j = 1; j <= per_producer; ++j)
+			{
+				// Mix the blocking and non-blocking operations.
+				if (j % 2 == 0)
+					q.push(j);
+				else
+				{
+					while (!q.try_push(j))
+						std::this_thread::yield();
+				}
+			}
+		});
+	}
+
+	for (int i = 0; i != consumers; ++i)
+	{
+		threads[producers + i] = std::thread([&, i] {
+			std::uint32_t v;
+			for (std::uint32_t j = 0; j != per_producer; ++j)
+			{
+				if (i == 0)
+					q.pop(v);
+				else
+				{
+					while (!q.try_pop(v))
+						std::this_thread::yield();
+				}
+
+				sum.fetch_add(v);
+				count.fetch_add(1);
+			}
+		});
+	}
+
+	for (std::thread & t: threads)
+		t.join();
+
+	REQUIRE(count == producers * per_producer);
+	REQUIRE(sum == std::uint64_t(producers) * per_producer * (per_producer + 1) / 2);
+}
+
+TEST_CASE("mutex provides mutual exclusion")
+{
+	avakar::mutex m;
+	REQUIRE(m.try_lock());
+	REQUIRE(!m.try_lock());
+	m.unlock();
+
+	std::uint64_t counter = 0;
+	std::thread threads[4];
+	for (std::thread & t: threads)
+	{
+		t = std::thread([&] {
+			for (int i = 0; i != 20000; ++i)
+			{
+				std::lock_guard<avakar::mutex> lock(m);
+				++counter;
+			}
+		});
+	}
+
+	for (std::thread & t: threads)
+		t.join();
+
+	REQUIRE(counter == 80000);
+	REQUIRE(m.try_lock());
+	m.unlock();
+}
+
+TEST_CASE("ticket_lock provides mutual exclusion across ticket wrap-around")
+{
+	avakar::ticket_lock m;
+
+	// Push the serving half through 0xffff.
+	for (int i = 0; i != 70000; ++i)
+	{
+		m.lock();
+		m.unlock();
+	}
+
+	REQUIRE(m.try_lock());
+	REQUIRE(!m.try_lock());
+	m.unlock();
+
+	std::uint64_t counter = 0;
+	std::thread threads[4];
+	for (std::thread & t: threads)
+	{
+		t = std::thread([&] {
+			for (int i = 0; i != 2000; ++i)
+			{
+				std::lock_guard<avakar::ticket_lock> lock(m);
+				++counter;
+			}
+		});
+	}
+
+	for (std::thread & t: threads)
+		t.join();
+
+	REQUIRE(counter == 8000);
+}
+
+TEST_CASE("mcs_lock provides mutual exclusion")
+{
+	avakar::mcs_lock m;
+
+	{
+		avakar::mcs_lock::node n1, n2;
+		REQUIRE(m.try_lock(n1));
+		REQUIRE(!m.try_lock(n2));
+		m.unlock(n1);
+	}
+
+	std::uint64_t counter = 0;
+	std::thread threads[4];
+	for (std::thread & t: threads)
+	{
+		t = std::thread([&] {
+			for (int i = 0; i != 2000; ++i)
+			{
+				avakar::mcs_lock::guard lock(m);
+				++counter;
+			}
+		});
+	}
+
+	for (std::thread & t: threads)
+		t.join();
+
+	REQUIRE(counter == 8000);
+}
+
+TEST_CASE("shared_mutex admits readers together and writers alone")
+{
+	avakar::shared_mutex m;
+
+	REQUIRE(m.try_lock_shared());
+	REQUIRE(m.try_lock_shared());
+	REQUIRE(!m.try_lock());
+	m.unlock_shared();
+	m.unlock_shared();
+
+	REQUIRE(m.try_lock());
+	REQUIRE(!m.try_lock_shared());
+	m.unlock();
+
+	std::uint64_t a = 0;
+	std::uint64_t b = 0;
+	std::atomic<bool> torn{ false };
+
+	std::thread threads[4];
+	for (int i = 0; i != 4; ++i)
+	{
+		threads[i] = std::thread([&, i] {
+			for (int j = 0; j != 5000; ++j)
+			{
+				if (i == 0 || j % 16 == 0)
+				{
+					std::lock_guard<avakar::shared_mutex> lock(m);
+					++a;
+					++b;
+				}
+				else
+				{
+					m.lock_shared();
+					if (a != b)
+						torn = true;
+					m.unlock_shared();
+				}
+			}
+		});
+	}
+
+	for (std::thread & t: threads)
+		t.join();
+
+	REQUIRE(!torn);
+	REQUIRE(a == 5000 + 3 * 313);
+	REQUIRE(m.try_lock());
+	m.unlock();
+}
+
+TEST_CASE("latch releases waiters once counted down")
+{
+	avakar::latch l(3);
+	REQUIRE(!l.try_wait());
+
+	std::atomic<int> done{ 0 };
+	std::thread waiter([&] {
+		l.wait();
+		done = 1;
+	});
+
+	l.count_down();
+	std::thread other([&] { l.count_down(2); });
+
+	waiter.join();
+	other.join();
+	REQUIRE(done == 1);
+	REQUIRE(l.try_wait());
+	l.arrive_and_wait(0);
+}
+
+TEST_CASE("barrier runs the completion once per phase")
+{
+	int phases = 0;
+	avakar::barrier<std::function<void()>> b(3, [&] { ++phases; });
+
+	int slots[3] = {};
+	std::atomic<bool> consistent{ true };
+
+	std::thread threads[3];
+	for (int i = 0; i != 3; ++i)
+	{
+		threads[i] = std::thread([&, i] {
+			for (int phase = 0; phase != 1000; ++phase)
+			{
+				slots[i] = phase;
+				b.arrive_and_wait();
+
+				// All threads have finished writing this phase.
+				if (slots[(i + 1) % 3] != phase)
+					consistent = false;
+				b.arrive_and_wait();
+			}
+
+			if (i == 2)
+				b.arrive_and_drop();
+		});
+	}
+
+	for (std::thread & t: threads)
+		t.join();
+
+	REQUIRE(consistent);
+	REQUIRE(phases == 2000);
+
+	// The dropped thread has arrived and is no longer expected.
+	b.arrive();
+	b.arrive_and_wait();
+	REQUIRE(phases == 2001);
+
+	b.arrive();
+	b.arrive_and_wait();
+	REQUIRE(phases == 2002);
+}
+
+TEST_CASE("counting_semaphore limits concurrency")
+{
+	avakar::counting_semaphore<2> sem(2);
+	REQUIRE(sem.try_acquire());
+	REQUIRE(sem.try_acquire());
+	REQUIRE(!sem.try_acquire());
+	sem.release(2);
+
+	std::atomic<int> inside{ 0 };
+	std::atomic<int> max_inside{ 0 };
+
+	std::thread threads[4];
+	for (std::thread & t: threads)
+	{
+		t = std::thread([&] {
+			for (int i = 0; i != 2000; ++i)
+			{
+				sem.acquire();
+				int n = ++inside;
+				int m = max_inside.load();
+				while (n > m && !max_inside.compare_exchange_weak(m, n))
+				{
+				}
+				--inside;
+				sem.release();
+			}
+		});
+	}
+
+	for (std::thread & t: threads)
+		t.join();
+
+	REQUIRE(max_inside <= 2);
+
+	avakar::binary_semaphore bin(0);
+	std::thread releaser([&] { bin.release(); });
+	bin.acquire();
+	releaser.join();
+	REQUIRE(!bin.try_acquire());
+}
+
+TEST_CASE("eventcount wakes blocked consumers of a lock-free queue")
+{
+	avakar::mpmc_queue<int> q(8);
+	avakar::eventcount ec;
+
+	int const count = 10000;
+	std::atomic<long> sum{ 0 };
+
+	auto consume = [&] {
+		for (;;)
+		{
+			int value;
+			if (!q.try_pop(value))
+			{
+				auto key = ec.prepare_wait();
+				if (q.try_pop(value))
+				{
+					ec.cancel_wait();
+				}
+				else
+				{
+					ec.commit_wait(key);
+					continue;
+				}
+			}
+
+			if (value < 0)
+				return;
+			sum += value;
+		}
+	};
+
+	std::thread consumers[2] = { std::thread(consume), std::thread(consume) };
+
+	for (int i = 1; i <= count + 2; ++i)
+	{
+		int value = i <= count? i: -1;
+		while (!q.try_push(value))
+			std::this_thread::yield();
+		ec.notify();
+	}
+
+	for (std::thread & t: consumers)
+		t.join();
+
+	REQUIRE(sum == long(count) * (count + 1) / 2);
+
+	// A notification after `prepare_wait` isn't lost, even if it comes
+	// before `commit_wait`.
+	auto key = ec.prepare_wait();
+	std::thread notifier([&] { ec.notify(); });
+	notifier.join();
+	ec.commit_wait(key);
+}
+
+TEST_CASE("fetch_update applies the transform atomically")
+{
+	avakar::atomic<std::uint32_t> a(5);
+	auto r = avakar::fetch_update(a, [](std::uint32_t v) { return v * 3; });
+	REQUIRE(r.old_value == 5);
+	REQUIRE(r.new_value == 15);
+	REQUIRE(a.load() == 15);
+
+	std::uint64_t x = 1;
+	avakar::atomic_ref<std::uint64_t> ref(x);
+	REQUIRE(avakar::update_and_fetch<avakar::no_backoff>(ref, [](std::uint64_t v) { return v << 4; }, std::memory_order_acq_rel) == 16);
+	REQUIRE(x == 16);
+
+	avakar::atomic<double> d(1.0);
+	auto rd = avakar::fetch_update<avakar::pause_backoff>(d, [](double v) { return v / 2; }, std::memory_order_release, std::memory_order_relaxed);
+	REQUIRE(rd.old_value == 1.0);
+	REQUIRE(d.load() == 0.5);
+
+	// A running sum, updated concurrently with different policies.
+	avakar::atomic<std::uint32_t> hi(0);
+	std::atomic<bool> monotonic{ true };
+
+	auto run = [&](auto policy) {
+		using Backoff = decltype(policy);
+		for (std::uint32_t i = 0; i != 5000; ++i)
+		{
+			auto res = avakar::fetch_update<Backoff>(hi, [&](std::uint32_t v) { return v + 1 + i; });
+			if (res.new_value <= res.old_value)
+				monotonic = false;
+		}
+	};
+
+	std::thread threads[4] = {
+		std::thread(run, avakar::no_backoff()),
+		std::thread(run, avakar::pause_backoff()),
+		std::thread(run, avakar::jittered_backoff()),
+		std::thread(run, avakar::yield_backoff()),
+	};
+
+	for (std::thread & t: threads)
+		t.join();
+
+	REQUIRE(monotonic);
+	REQUIRE(hi.load() == 4 * (5000 + 4999u * 5000 / 2));
+}
+
+TEST_CASE("flat_combining applies every operation exactly once")
+{
+	avakar::flat_combining<std::vector<int>, 4> fc;
+	std::atomic<bool> ok{ true };
+
+	std::thread threads[6];
+	for (int t = 0; t != 6; ++t)
+	{
+		threads[t] = std::thread([&, t] {
+			for (int i = 0; i != 2000; ++i)
+			{
+				std::size_t size = fc.apply([&](std::vector<int> & v) {
+					v.push_back(t * 2000 + i);
+					return v.size();
+				});
+
+				if (size == 0)
+					ok = false;
+			}
+		});
+	}
+
+	for (std::thread & t: threads)
+		t.join();
+
+	REQUIRE(ok);
+
+	std::vector<int> & v = fc.unsafe_get();
+	REQUIRE(v.size() == 12000);
+	std::sort(v.begin(), v.end());
+	REQUIRE(std::adjacent_find(v.begin(), v.end()) == v.end());
+	REQUIRE(v.front() == 0);
+	REQUIRE(v.back() == 11999);
+
+	fc.apply([](std::vector<int> & v) { v.clear(); });
+	REQUIRE(fc.apply([](std::vector<int> & v) { return v.empty(); }));
+	REQUIRE_THROWS_AS(fc.apply([](std::vector<int> & v) { return v.at(1); }), std::out_of_range);
+}
+
+namespace {
+
+struct stack_node
+	: avakar::treiber_stack_hook
+{
+	explicit stack_node(int value)
+		: value(value)
+	{
+	}
+
+	int value;
+};
+
+}
+
+TEST_CASE("treiber_stack pops what was pushed")
+{
+	avakar::treiber_stack<stack_node> stack;
+	REQUIRE(stack.empty());
+	REQUIRE(stack.pop() == nullptr);
+
+	stack_node a(1), b(2), c(3);
+	stack.push(&a);
+	avakar::treiber_stack<stack_node>::set_next(&b, &c);
+	stack.push_list(&b, &c);
+
+	REQUIRE(stack.pop() == &b);
+	REQUIRE(stack.pop() == &c);
+	REQUIRE(stack.pop() == &a);
+	REQUIRE(stack.empty());
+
+	std::deque<stack_node> nodes;
+	for (int i = 0; i != 64; ++i)
+		nodes.emplace_back(i);
+
+	// Threads keep popping nodes and pushing them back.
+	for (stack_node & n: nodes)
+		stack.push(&n);
+
+	std::thread threads[4];
+	for (std::thread & t: threads)
+	{
+		t = std::thread([&] {
+			for (int i = 0; i != 20000; ++i)
+			{
+				if (stack_node * n = stack.pop())
+					stack.push(n);
+			}
+		});
+	}
+
+	for (std::thread & t: threads)
+		t.join();
+
+	int count = 0;
+	long sum = 0;
+	for (stack_node * n = stack.pop_all(); n != nullptr; n = avakar::treiber_stack<stack_node>::next(n))
+	{
+		++count;
+		sum += n->value;
+	}
+
+	REQUIRE(count == 64);
+	REQUIRE(sum == 63 * 64 / 2);
+	REQUIRE(stack.empty());
+}
+
+TEST_CASE("object_pool recycles objects through per-thread caches")
+{
+	avakar::object_pool<std::string, 8> pool;
+
+	{
+		avakar::object_pool<std::string, 8>::cache cache(pool);
+		std::string * s = cache.create("hello");
+		REQUIRE(*s == "hello");
+		cache.destroy(s);
+
+		// The last freed object is handed out first.
+		REQUIRE(cache.create("world") == s);
+		cache.destroy(s);
+	}
+
+	std::atomic<bool> ok{ true };
+	std::string * shared[4] = {};
+
+	std::thread threads[4];
+	for (int t = 0; t != 4; ++t)
+	{
+		threads[t] = std::thread([&, t] {
+			avakar::object_pool<std::string, 8>::cache cache(pool);
+
+			std::vector<std::string *> held;
+			for (int i = 0; i != 5000; ++i)
+			{
+				held.push_back(cache.create(std::to_string(t * 5000 + i)));
+				if (held.size() == 20)
+				{
+					for (std::size_t j = 0; j != held.size(); ++j)
+					{
+						if (*held[j] != std::to_string(t * 5000 + i - 19 + int(j)))
+							ok = false;
+						cache.destroy(held[j]);
+					}
+					held.clear();
+				}
+			}
+
+			// Freed by another thread's cache below.
+			shared[t] = cache.create("shared");
+			for (std::string * s: held)
+				cache.destroy(s);
+		});
+	}
+
+	for (std::thread & t: threads)
+		t.join();
+
+	REQUIRE(ok);
+
+	avakar::object_pool<std::string, 8>::cache cache(pool);
+	for (std::string * s: shared)
+	{
+		REQUIRE(*s == "shared");
+		cache.destroy(s);
+	}
+}